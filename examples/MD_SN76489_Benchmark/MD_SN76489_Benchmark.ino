@@ -0,0 +1,131 @@
+// MD_SN74689 Library example program.
+//
+// Measures the number of register writes per second that can be sent to
+// the SN76489 IC and compares this to a reference implementation using
+// the digitalWrite() loop from earlier versions of the library.
+//
+// Results are printed on the Serial Monitor. The bytes written only turn
+// the channel attenuators to off, so no sound is produced.
+//
+
+#include <MD_SN76489.h>
+
+// Define if we are using a direct or SPI interface to the sound IC
+// 1 = use direct, 0 = use SPI
+#ifndef USE_DIRECT
+#define USE_DIRECT 1
+#endif
+
+// If using SPI, define if we are using the hardware SPI peripheral
+// 1 = use hardware SPI, 0 = use shiftOut()
+#ifndef USE_HW_SPI
+#define USE_HW_SPI 1
+#endif
+
+// Hardware Definitions ---------------
+#if USE_DIRECT
+// All the pins directly connected to D0-D7 on the IC, in sequential order
+// so that pin D_PIN[0] is connected to D0, D_PIN[1] to D1, etc.
+const uint8_t D_PIN[] = { A0, A1, A2, A3, 4, 5, 6, 7 };
+#else
+// Define the SPI related pins
+const uint8_t LD_PIN = 10;
+const uint8_t DAT_PIN = 11;
+const uint8_t CLK_PIN = 13;
+#endif
+const uint8_t WE_PIN = 8;     // Arduino pin connected to the IC WE pin
+
+// Global Data ------------------------
+#if USE_DIRECT
+MD_SN76489_Direct S(D_PIN, WE_PIN, true);
+#elif USE_HW_SPI
+MD_SN76489_SPI S(LD_PIN, WE_PIN, true, 8000000UL);
+#else
+MD_SN76489_SPI S(LD_PIN, DAT_PIN, CLK_PIN, WE_PIN, true);
+#endif
+
+const uint16_t TEST_WRITES = 10000;   // number of writes timed for each test
+
+// Attenuator off for all channels
+const uint8_t testData[] = { 0x9f, 0xbf, 0xdf, 0xff };
+
+// Code -------------------------------
+void refSend(uint8_t data)
+// Reference byte send implementation using the Arduino I/O functions
+{
+  digitalWrite(WE_PIN, HIGH);
+
+#if USE_DIRECT
+  for (int8_t i = 7; i >= 0; i--)
+    digitalWrite(D_PIN[7 - i], (data & bit(i)) ? HIGH : LOW);
+#else
+  digitalWrite(LD_PIN, LOW);
+  shiftOut(DAT_PIN, CLK_PIN, MSBFIRST, data);
+  digitalWrite(LD_PIN, HIGH);
+#endif
+
+  digitalWrite(WE_PIN, LOW);
+  delayMicroseconds(10);
+  digitalWrite(WE_PIN, HIGH);
+}
+
+void report(const __FlashStringHelper *label, uint32_t elapsed, uint8_t bytesPerWrite = 1)
+{
+  Serial.print(F("\n"));
+  Serial.print(label);
+  Serial.print(F(": "));
+  Serial.print(elapsed);
+  Serial.print(F("us -> "));
+  Serial.print((TEST_WRITES * 1000000.0 * bytesPerWrite) / elapsed, 0);
+  Serial.print(F(" bytes/s"));
+}
+
+void setup(void)
+{
+  uint32_t timeStart;
+
+  Serial.begin(57600);
+  Serial.println(F("[MD_SN76489 Benchmark]"));
+
+  S.begin();
+
+  // reference implementation
+  timeStart = micros();
+  for (uint16_t i = 0; i < TEST_WRITES; i++)
+    refSend(testData[i & 3]);
+  report(F("Reference"), micros() - timeStart);
+
+  // library single byte writes
+  timeStart = micros();
+  for (uint16_t i = 0; i < TEST_WRITES; i++)
+    S.write(testData[i & 3]);
+  report(F("Library  "), micros() - timeStart);
+
+  // library buffered writes, a frame of 4 bytes per call
+  timeStart = micros();
+  for (uint16_t i = 0; i < TEST_WRITES; i += ARRAY_SIZE(testData))
+    S.write(testData, ARRAY_SIZE(testData));
+  report(F("Library burst"), micros() - timeStart);
+
+  // reference frequency updates (latch + data byte)
+  timeStart = micros();
+  for (uint16_t i = 0; i < TEST_WRITES; i++)
+  {
+    refSend(0x80 | (i & 0xf));  // channel 0 tone latch
+    refSend(0x08);              // data byte
+  }
+  report(F("Reference freq"), micros() - timeStart, 2);
+
+  // library frequency updates, sent as a burst
+  timeStart = micros();
+  for (uint16_t i = 0; i < TEST_WRITES; i++)
+    S.setFrequency(0, 440 + (i & 0xf));
+  report(F("Library freq  "), micros() - timeStart, 2);
+  S.setVolume(MD_SN76489::VOL_OFF);
+
+  Serial.print(F("\n\nDone"));
+}
+
+void loop(void)
+{
+}
@@ -0,0 +1,73 @@
+// MD_SN74689 Library example program.
+//
+// Plays a short VGM jingle stored in program memory, repeating every few
+// seconds. No SD card is needed.
+//
+// The jingle.h header was made from a VGM file with the vgm2h tool in the
+// library tools folder (MD_SN76489_VGMToH). Replace it with any other
+// short VGM file converted the same way.
+//
+// VGM file format at https://vgmrips.net/wiki/VGM_Specification
+//
+
+#include <MD_SN76489.h>
+#include "jingle.h"
+
+// Define if we are using a direct or SPI interface to the sound IC
+// 1 = use direct, 0 = use SPI
+#ifndef USE_DIRECT
+#define USE_DIRECT 1
+#endif
+
+// Hardware Definitions ---------------
+#if USE_DIRECT
+// All the pins directly connected to D0-D7 on the IC, in sequential order 
+// so that pin D_PIN[0] is connected to D0, D_PIN[1] to D1, etc.
+const uint8_t D_PIN[] = { A0, A1, A2, A3, 4, 5, 6, 7 };
+#else
+// Define the SPI related pins
+const uint8_t LD_PIN = 10;
+const uint8_t DAT_PIN = 11;
+const uint8_t CLK_PIN = 13;
+#endif
+const uint8_t WE_PIN = 8;     // Arduino pin connected to the IC WE pin
+
+const uint16_t PAUSE_TIME = 3000; // pause between repeats in ms
+
+// Global Data ------------------------
+#if USE_DIRECT
+MD_SN76489_Direct S(D_PIN, WE_PIN, true);
+#else
+MD_SN76489_SPI S(LD_PIN, DAT_PIN, CLK_PIN, WE_PIN, true);
+#endif
+MD_SN76489_VGMMemory M(jingle, sizeof(jingle), true);  // data is in PROGMEM
+MD_SN76489_VGM VGM(S);
+
+// Code -------------------------------
+void setup(void)
+{
+  Serial.begin(57600);
+  Serial.println(F("[MD_SN76489 VGM Flash Player]"));
+
+  S.begin();
+  S.setVolume(MD_SN76489::VOL_OFF);
+}
+
+void loop(void)
+{
+  static uint32_t timeEnd = 0;
+
+  if (VGM.isPlaying())
+  {
+    // send the music data that is due
+    if (!VGM.poll())
+      timeEnd = millis();
+  }
+  else if (millis() - timeEnd >= PAUSE_TIME)
+  {
+    // start again from the beginning
+    M.reset();
+    if (VGM.start(M))
+      Serial.println(F("Play"));
+  }
+}
@@ -0,0 +1,18 @@
+// VGM file jingle.vgm (C major arpeggio) converted by vgm2h
+// 166 bytes
+#pragma once
+
+const uint8_t PROGMEM jingle[] =
+{
+  0x56, 0x67, 0x6d, 0x20, 0xa2, 0x00, 0x00, 0x00, 0x50, 0x01, 0x00, 0x00, 0x99, 0x9e, 0x36, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc9, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x50, 0x86, 0x50, 0x0d, 0x50, 0x92, 0x63, 0x62, 0x62, 0x62, 0x62, 0x62, 0x62, 0x50, 0xaa, 0x50,
+  0x0a, 0x50, 0xb2, 0x63, 0x62, 0x62, 0x62, 0x62, 0x62, 0x62, 0x50, 0xcf, 0x50, 0x08, 0x50, 0xd2,
+  0x63, 0x62, 0x62, 0x62, 0x62, 0x62, 0x62, 0x50, 0x8b, 0x50, 0x06, 0x50, 0x92, 0x63, 0x62, 0x62,
+  0x62, 0x62, 0x62, 0x62, 0x50, 0x92, 0x50, 0xb2, 0x50, 0xd2, 0x62, 0x50, 0x94, 0x50, 0xb4, 0x50,
+  0xd4, 0x62, 0x50, 0x96, 0x50, 0xb6, 0x50, 0xd6, 0x62, 0x50, 0x98, 0x50, 0xb8, 0x50, 0xd8, 0x62,
+  0x50, 0x9a, 0x50, 0xba, 0x50, 0xda, 0x62, 0x50, 0x9c, 0x50, 0xbc, 0x50, 0xdc, 0x62, 0x50, 0x9e,
+  0x50, 0xbe, 0x50, 0xde, 0x62, 0x66,
+};
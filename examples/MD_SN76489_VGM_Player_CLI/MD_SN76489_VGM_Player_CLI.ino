@@ -1,4 +1,5 @@
 // Command Line Interface (Serial) to play VGM files from the SD card.
+// Compressed .vgz files are played as they are if USE_VGZ is enabled.
 // 
 // Enter commands on the serial monitor to control the application
 //
@@ -19,6 +20,31 @@
 #define USE_DIRECT 1
 #endif
 
+// Define if compressed .vgz files can be played
+// 1 = play .vgm and .vgz, 0 = .vgm only. The decompression window needs
+// SN_VGZ_WINDOW bytes of RAM (32kB by default), too much for an Uno.
+#ifndef USE_VGZ
+#ifdef __AVR__
+#define USE_VGZ 0
+#else
+#define USE_VGZ 1
+#endif
+#endif
+
+// Number of checkpoints kept for seeking with the 'j' command. Each uses
+// 28 bytes of RAM. On an Uno (2kB RAM) the SD card library, the file 
+// buffers (2 x SN_VGM_BLOCK, 128 bytes each on the Uno) and the Serial 
+// buffers use most of the RAM, so only a small index is kept there and
+// seeking far into a file is slower. Boards with more RAM (eg, Mega) keep
+// a larger index.
+#ifndef SEEK_POINTS
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define SEEK_POINTS 2
+#else
+#define SEEK_POINTS 8
+#endif
+#endif
+
 // Hardware Definitions ---------------
 #if USE_DIRECT
 // All the pins directly connected to D0-D7 on the IC, in sequential order 
@@ -37,133 +63,81 @@ const uint8_t SD_SELECT = 10;
 
 // Miscellaneous
 void(*hwReset) (void) = 0;            // declare reset function @ address 0
-const uint16_t SAMPLE_uS = 23; // 1e6 us/sec at 44100 samples/sec = 22.67us per sample
+
+// VGM data source reading the SD file in whole sectors. The library
+// reads the next sector while the player is waiting between notes.
+class VGMFile: public MD_SN76489_VGMBlockSource
+{
+public:
+  SdFile FD;    // file descriptor
+
+protected:
+  size_t readBlock(uint8_t* buf, size_t len)
+  {
+    int n = FD.read(buf, len);
+
+    return(n < 0 ? 0 : n);
+  }
+
+  bool seekBlock(uint32_t pos) { return(FD.seekSet(pos)); }
+};
 
 // Global Data ------------------------
 SdFat SD;
-SdFile FD;    // file descriptor
+VGMFile VF;
 #if USE_DIRECT
 MD_SN76489_Direct S(D_PIN, WE_PIN, true);
 #else
 MD_SN76489_SPI S(LD_PIN, DAT_PIN, CLK_PIN, WE_PIN, true);
 #endif
+#if USE_VGZ
+MD_SN76489_VGZSource VZ(VF);    // decompresses VF, or passes uncompressed data through
+#define VGM_SOURCE VZ
+#else
+#define VGM_SOURCE VF
+#endif
+MD_SN76489_VGM VGM(S);
+MD_SN76489_VGM::checkpoint_t seekIndex[SEEK_POINTS];  // checkpoints for seeking in the file
 
-uint32_t dataOffset = 0;    // offset to start of music data in VGM file
-bool playingVGM = false;    // flag true when in playing mode
-
-
-void playVGM(void)
-{
-  uint32_t samples = 0;
-  int cmd = FD.read();
-
-  if (cmd == -1) cmd = 0x66;    // make this stop
-  
-  switch (cmd)
-  {
-    case 0x50: // 0x50 dd : PSG (SN76489/SN76496) write value dd
-    {
-      uint8_t data = FD.read();
-      S.write(data);
-    }
-    break;
-
-    case 0x61: // 0x61 nn nn : Wait n samples, n can range from 0 to 65535
-      samples = FD.read() & 0x00FF;
-      samples |= (FD.read() << 8) & 0xFF00;
-      delay((samples * SAMPLE_uS) / 1000);
-      break;
-
-    case 0x62: // wait 735 samples (60th of a second)
-      delay(17);  // SAMPLE_uS * 735 = 16.905ms
-      break;
-
-    case 0x63: // wait 882 samples (50th of a second)
-      delay(20);  // SAMPLE_uS * 882 = 20.286ms
-      break;
-
-    case 0x70 ... 0x7f: // 0x7n : wait n+1 samples, n can range from 0 to 15
-      samples = cmd + 0x70 + 1;
-      delayMicroseconds(samples * SAMPLE_uS);
-      break;
-
-    case 0x66: // 0x66 : end of sound data
-      handlerS(nullptr);
-      break;
-
-    default:
-      break;
-  } //end switch
-}
-
-uint32_t readVGMDword(uint16_t fileOffset)
-// All integer values are *unsigned* and written in 
-// "Intel" byte order (Little Endian), so for example 
-// 0x12345678 is written as 0x78 0x56 0x34 0x12.
-{
-  uint8_t data[4];
-  uint32_t result;
-
-  FD.seekSet(fileOffset);
-  for (uint8_t i = 0; i < ARRAY_SIZE(data); i++)
-    data[i] = FD.read() & 0xff;
-
-  result = 0;
-  for (int8_t i = ARRAY_SIZE(data) - 1; i >= 0; i--)
-    result = (result << 8) | data[i];
-
-  return(result);
-}
-
-uint16_t checkVGMHeader(char* file)
+bool openVGM(char* file)
 {
-  uint32_t offset = 0;
-  uint32_t x, version;
-
   // try to open the file
   if (file[0] == '\0')
-    return(0);
+    return(false);
 
-  if (!FD.open(file, O_READ))
+  if (!VF.FD.open(file, O_READ))
   {
     Serial.print(F("\nFile not found."));
-    return(0);
+    return(false);
   }
 
-  // read the header for VGM signature (0x00)
-  x = readVGMDword(0x00);
-  if (x != 0x206d6756) // " mgV"
+  // read the header and get ready to play
+  VF.reset();
+#if USE_VGZ
+  VZ.reset();
+#endif
+  if (!VGM.start(VGM_SOURCE))
   {
-    Serial.print("\nNot a VGM file: 0x");
-    Serial.print(x, HEX);
-    return(0);
+    Serial.print(F("\nNot a VGM file."));
+    VF.FD.close();
+    return(false);
   }
 
-  // get the VGM version (0x08)
-  version = readVGMDword(0x08);
   Serial.print(F("\nVGM version: 0x"));
-  Serial.print(version, HEX);
-
-  // verify SN76489 clock speed (0x0c)
-  x = readVGMDword(0x0c);
+  Serial.print(VGM.getVersion(), HEX);
   Serial.print(F("\nSN76489 clock: "));
-  Serial.print(x);
-
-  // get the relative data offset value (0x34)
-  if (version < 0x150)
-    offset = 0x40;
-  else
+  Serial.print(VGM.getClock());
+  Serial.print(F("\nLength: "));
+  Serial.print(VGM.getTotalSamples() / MD_SN76489_VGM::SAMPLE_RATE);
+  Serial.print(F("s"));
+  if (VGM.getLoopSamples() != 0)
   {
-    offset = readVGMDword(0x34);
-    offset += 0x34;  // make it absolute
+    Serial.print(F(", loops from "));
+    Serial.print((VGM.getTotalSamples() - VGM.getLoopSamples()) / MD_SN76489_VGM::SAMPLE_RATE);
+    Serial.print(F("s"));
   }
-  //Serial.print(F("\nData offset: 0x"));
-  //Serial.print(offset, HEX);
-
-  // set up the next character read at the data offset
-  FD.seekSet(offset);
 
-  return(offset);
+  return(true);
 }
 
 void handlerHelp(char* param); // function prototype only
@@ -173,18 +147,31 @@ void handlerZ(char *param) { hwReset(); }
 void handlerS(char* param)
 // Stop play
 { 
-  S.setVolume(MD_SN76489::VOL_OFF);
-  playingVGM = false;
-  FD.close();
+  VGM.stop();
+  VF.FD.close();
 }
 
 void handlerP(char *param)
 // Play
 {
+  if (VGM.isPlaying())
+    handlerS(nullptr);
+
   Serial.print(F("\n\nVGM file: "));
   Serial.print(param);
-  dataOffset = checkVGMHeader(param); // load the new file
-  playingVGM = (dataOffset != 0);
+  openVGM(param); // load the new file
+}
+
+void handlerJ(char* param)
+// Jump to a time in seconds
+{
+  uint32_t t = strtoul(param, nullptr, 10);
+
+  Serial.print(F("\nJump to "));
+  Serial.print(t);
+  Serial.print(F("s"));
+  if (!VGM.seek(t * MD_SN76489_VGM::SAMPLE_RATE))
+    Serial.print(F(" failed."));
 }
 
 void handlerF(char *param)
@@ -222,6 +209,7 @@ const MD_cmdProcessor::cmdItem_t PROGMEM cmdTable[] =
   { "l", handlerL,    "",     "list files in current folder" },
   { "p", handlerP,    "file", "play the named file" },
   { "s", handlerS,    "",     "stop playing current file" },
+  { "j", handlerJ,    "t",    "jump to t seconds in current file" },
   { "z", handlerZ,    "",     "software reset" },
 };
 
@@ -239,6 +227,10 @@ void setup(void) // This is run once at power on
   S.begin();
   S.setVolume(MD_SN76489::VOL_OFF);
 
+  // Play each loop twice, and save checkpoints for seeking as the files play
+  VGM.setLoops(2);
+  VGM.setIndex(seekIndex, ARRAY_SIZE(seekIndex));
+
   // Initialize SD
   if (!SD.begin(SD_SELECT, SPI_FULL_SPEED))
   {
@@ -255,8 +247,9 @@ void setup(void) // This is run once at power on
 
 void loop(void)
 {
-  if (playingVGM) 
-    playVGM();
-  //else
-    CP.run();  // process the User Interface
+  // send any music data that is due, close the file at the end
+  if (VGM.isPlaying() && !VGM.poll())
+    VF.FD.close();
+
+  CP.run();  // process the User Interface
 }
\ No newline at end of file
@@ -24,8 +24,35 @@ See header file for copyright and licensing comments.
 #define DEBUG(s, v)
 #endif
 
+// MIDI note to tone divider table, worked out by the compiler for SN_CLOCK_HZ.
+// MIDI note 0 is C-1 at 8.1758Hz and each note is a semitone (2^(1/12)) higher. 
+// The dividers are not limited to the IC range [1..1023] here, only to 16 bits,
+// so that notes brought into range by scaling for another clock are right.
+static constexpr double midiSemitone(uint8_t s) { return(s == 0 ? 1.0 : 1.0594630943592953 * midiSemitone(s - 1)); }
+static constexpr double midiFrequency(uint8_t n) { return(8.175798915643707 * (double)(1UL << (n / 12)) * midiSemitone(n % 12)); }
+static constexpr uint16_t midiLimit(double d) { return(d < 1.0 ? 1 : (d > 65535.0 ? 65535 : (uint16_t)d)); }
+static constexpr uint16_t midiDivider(uint8_t n) { return(midiLimit((SN_CLOCK_HZ / (32.0 * midiFrequency(n))) + 0.5)); }
+
+// Known dividers at the default clock: A4 (440Hz) is 284 and C4 (261.63Hz) is 478
+static_assert(SN_CLOCK_HZ != 4000000UL || (midiDivider(69) == 284 && midiDivider(60) == 478), "MIDI note table not worked out correctly");
+
+#define MIDI_DIV4(n)  midiDivider(n), midiDivider(n + 1), midiDivider(n + 2), midiDivider(n + 3)
+#define MIDI_DIV16(n) MIDI_DIV4(n), MIDI_DIV4(n + 4), MIDI_DIV4(n + 8), MIDI_DIV4(n + 12)
+#define MIDI_DIV64(n) MIDI_DIV16(n), MIDI_DIV16(n + 16), MIDI_DIV16(n + 32), MIDI_DIV16(n + 48)
+
+static const uint16_t PROGMEM midiDividerTable[128] = { MIDI_DIV64(0), MIDI_DIV64(64) };
+
+// Reciprocal 2^31/m for a frequency m normalized to [0x8000..0xffff], indexed
+// by the 6 bits below the top bit and taken at the middle of each interval.
+static constexpr uint16_t recipEntry(uint8_t i) { return((uint16_t)((1UL << 31) / (0x8000UL + ((uint32_t)i << 9) + 0x100))); }
+
+#define RECIP4(n)  recipEntry(n), recipEntry(n + 1), recipEntry(n + 2), recipEntry(n + 3)
+#define RECIP16(n) RECIP4(n), RECIP4(n + 4), RECIP4(n + 8), RECIP4(n + 12)
+
+static const uint16_t PROGMEM recipTable[64] = { RECIP16(0), RECIP16(16), RECIP16(32), RECIP16(48) };
+
 // Class methods
-MD_SN76489::MD_SN76489(bool clock): _clock(clock)
+MD_SN76489::MD_SN76489(bool clock): _clockHz(SN_CLOCK_HZ), _clock(clock)
 {
   _adsrDefault.invert = false;    // Normal non-inverted curve
   _adsrDefault.Ta = 40;           // Time for attack curve to reach Vmax
@@ -40,6 +67,30 @@ void MD_SN76489::begin(void)
   if (_clock)
     startClock();
 
+  // Work out the time needed by the IC to latch data, rounded up
+  _writeUs = (((uint32_t)WRITE_CYCLES * 1000000UL) + _clockHz - 1) / _clockHz;
+
+  // Work out the constants for the tone divider calculations
+  _clockK = _clockHz >> 5;    // >>5 same as /32
+  _clockKsh = 0;
+  while ((_clockK >> _clockKsh) > 0x7fff)
+    _clockKsh++;
+  _clockKn = _clockK >> _clockKsh;
+  _freqMin = (_clockK / (DIVIDER_MAX + 1)) + 1;
+  _midiScale = (uint32_t)(((uint64_t)_clockHz << 16) / SN_CLOCK_HZ);
+
+  // Nothing is known about the IC registers yet
+  _regs.reset();
+  _suppressed = 0;
+
+#if SN_QUEUE_SIZE
+  // Empty write queue
+  _qHead = _qTail = 0;
+  _qClear = false;
+  _qHighWater = 0;
+  _qOverflow = 0;
+#endif
+
   for (uint8_t i = 0; i < MAX_CHANNELS; i++)
   {
     C[i].state = IDLE;
@@ -65,6 +116,7 @@ bool MD_SN76489::setADSR(uint8_t chan, adsrEnvelope_t* padsr)
 
   if (chan < MAX_CHANNELS)
   {
+    SN_LOCK();
     if (isIdle(chan))
     {
       if (padsr == nullptr)
@@ -73,6 +125,7 @@ bool MD_SN76489::setADSR(uint8_t chan, adsrEnvelope_t* padsr)
         C[chan].adsr = padsr;
       b = true;
     }
+    SN_UNLOCK();
   }
 
   return(b);
@@ -115,10 +168,11 @@ void MD_SN76489::tone(byte chan, uint16_t freq, uint8_t volume, uint16_t duratio
   {
     DEBUGS(" note ");
 
+    SN_LOCK();
     if (freq != 0)
     {
       DEBUGS("on");
-      C[chan].frequency = freq;
+      C[chan].divider = freqToDivider(freq);
       C[chan].volSP = C[chan].volCV = saneVolume(volume);
       C[chan].duration = duration;
       C[chan].playTone = true;
@@ -129,6 +183,7 @@ void MD_SN76489::tone(byte chan, uint16_t freq, uint8_t volume, uint16_t duratio
       DEBUGS("off");
       C[chan].state = IDLE;
     }
+    SN_UNLOCK();
   }
 }
 
@@ -137,14 +192,53 @@ void MD_SN76489::note(byte chan, uint16_t freq, uint8_t volume, uint16_t duratio
 {
   DEBUG("\nnote C", chan);
   DEBUG(" F", freq);
+  noteDivider(chan, (freq == 0) ? 0 : freqToDivider(freq), volume, duration);
+}
+
+void MD_SN76489::begin(uint32_t clockHz)
+{
+  if (clockHz != 0)
+    _clockHz = clockHz;
+
+  begin();
+}
+
+void MD_SN76489::noteMidi(uint8_t chan, uint8_t midiNote, uint8_t volume, uint16_t duration)
+// queue a MIDI note to be played with ADSR
+{
+  DEBUG("\nnoteMidi C", chan);
+  DEBUG(" N", midiNote);
+  if (midiNote > 127)
+    noteDivider(chan, 0, volume, duration);
+  else
+  {
+    uint32_t div = pgm_read_word(&midiDividerTable[midiNote]);
+
+    // scale the table divider if the clock is not SN_CLOCK_HZ, then limit
+    // it to the IC range
+    if (div > (0xffffffffUL - 0x8000) / _midiScale)
+      div = DIVIDER_MAX;
+    else
+      div = ((div * _midiScale) + 0x8000) >> 16;
+    if (div < 1) div = 1;
+    if (div > DIVIDER_MAX) div = DIVIDER_MAX;
+
+    noteDivider(chan, div, volume, duration);
+  }
+}
+
+void MD_SN76489::noteDivider(uint8_t chan, uint16_t div, uint8_t volume, uint16_t duration)
+// queue a tone divider to be played with ADSR, 0 for note off
+{
   if (chan < MAX_CHANNELS - 1)   // noise channel not valid for this
   {
     DEBUGS(" note ");
 
-    if (freq != 0)
+    SN_LOCK();
+    if (div != 0)
     {
       DEBUGS("on");
-      C[chan].frequency = freq;
+      C[chan].divider = div;
       C[chan].volSP = C[chan].volCV = saneVolume(volume);
       C[chan].duration = calcTs(chan, duration);
       C[chan].playTone = false;
@@ -155,6 +249,7 @@ void MD_SN76489::note(byte chan, uint16_t freq, uint8_t volume, uint16_t duratio
       DEBUGS("off");
       C[chan].state = NOTE_OFF;
     }
+    SN_UNLOCK();
   }
 }
 
@@ -164,10 +259,11 @@ void MD_SN76489::noise(noiseType_t noise, uint8_t volume, uint16_t duration)
   {
     DEBUG("\nnoise ", noise);
 
+    SN_LOCK();
     if (noise != NOISE_OFF)
     {
       DEBUGS("on");
-      C[NOISE_CHANNEL].frequency = noise;
+      C[NOISE_CHANNEL].divider = noise;
       C[NOISE_CHANNEL].volSP = C[NOISE_CHANNEL].volCV = saneVolume(volume);
       C[NOISE_CHANNEL].duration = calcTs(NOISE_CHANNEL, duration);
       C[NOISE_CHANNEL].state = NOISE_ON;
@@ -177,10 +273,22 @@ void MD_SN76489::noise(noiseType_t noise, uint8_t volume, uint16_t duration)
       DEBUGS("off");
       C[NOISE_CHANNEL].state = NOTE_OFF;
     }
+    SN_UNLOCK();
   }
 }
 
-void MD_SN76489::play(void)
+void MD_SN76489::play(uint32_t now)
+{
+#if SN_TIMER_PLAY
+  // the timer interrupt is running the envelopes
+  if (_timerObj == this)
+    return;
+#endif
+
+  runFSM(now);
+}
+
+void MD_SN76489::runFSM(uint32_t now)
 {
   for (uint8_t chan = 0; chan < MAX_CHANNELS; chan++)
   {
@@ -199,17 +307,13 @@ void MD_SN76489::play(void)
       DEBUGS("\n->NOTE/NOISE_ON");
 
       if (C[chan].state == NOTE_ON)
-        setFrequency(chan, C[chan].frequency);   // set channel frequency
+        setDivider(chan, C[chan].divider);   // set channel frequency
       else
-        setNoise((noiseType_t)(C[chan].frequency));
-
-      // set timing parameters for ATTACK phase
-      C[chan].timeBase = millis();
-      C[chan].timeStep = (C[chan].adsr->Ta / C[chan].volSP);
+        setNoise((noiseType_t)(C[chan].divider));
 
-      // set inital playing volume and volume step direction
+      // set inital playing volume and timing parameters for ATTACK phase
       setCVolume(chan, C[chan].adsr->invert ? C[chan].volSP : 0);
-      C[chan].volumeStep = C[chan].adsr->invert ? -1 : 1;
+      startPhase(chan, now, C[chan].adsr->Ta, C[chan].adsr->invert ? 0 : C[chan].volSP);
 
       DEBUGS("\n->NOTE/NOISE_ON to ATTACK");
       C[chan].state = ATTACK;
@@ -221,10 +325,10 @@ void MD_SN76489::play(void)
       DEBUGS("\n->TONE_ON");
 
       // set channel frequency
-      setFrequency(chan, C[chan].frequency);
+      setDivider(chan, C[chan].divider);
 
       // set timing parameters for SUSTAIN phase
-      C[chan].timeBase = millis();
+      C[chan].timeBase = now;
 
       // set inital playing volume
       setCVolume(chan, C[chan].volSP);
@@ -235,58 +339,62 @@ void MD_SN76489::play(void)
     break;
 
     case ATTACK:
+    case DECAY:
+    case RELEASE:
     {
-      // check if enough time has passed to do something
-      if (millis() - C[chan].timeBase >= C[chan].timeStep)
+      // Do all the steps that are due, as there may be more than one 
+      // if the steps are shorter than the time between calls. Only 
+      // the final volume is written to the IC.
+      uint8_t v = C[chan].volCV;
+
+      while ((C[chan].state == ATTACK || C[chan].state == DECAY || C[chan].state == RELEASE) &&
+             (now - C[chan].timeBase >= stepTime(chan)))
       {
-        // if the current level was the end of the interval
-        if ((C[chan].adsr->invert && C[chan].volCV == 0) ||
-            (!C[chan].adsr->invert && C[chan].volCV == C[chan].volSP))
+        // step the volume and move the time base to when the step was due
+        if (C[chan].volCV != C[chan].volEnd)
         {
-          // set timing parameters for DECAY phase
-          C[chan].timeBase = millis();
-          C[chan].timeStep = C[chan].adsr->Td / C[chan].adsr->deltaVs;
-
-          // reverse volume step direction from current one
-          C[chan].volumeStep *= -1;
+          DEBUG("\n--ADSR Volume delta ", C[chan].volumeStep);
+          DEBUG(" CV:", C[chan].volCV);
+          uint32_t t = C[chan].timeAcc + ((C[chan].timeStep & 0xffff) * SN_TIME_SCALE);
 
-          DEBUGS("\n->ATTACK to DECAY");
-          C[chan].state = DECAY;
+          C[chan].timeBase += ((C[chan].timeStep >> 16) * SN_TIME_SCALE) + (t >> 16);
+          C[chan].timeAcc = t & 0xffff;
+          C[chan].volCV += C[chan].volumeStep;
         }
-        else
+
+        // if the current level is the end of the phase, start the next 
+        // phase from the time the last step was due
+        if (C[chan].volCV == C[chan].volEnd)
         {
-          DEBUG("\n--ATTACK Volume delta:", C[chan].volumeStep);
-          DEBUG(" CV:", C[chan].volCV);
-          DEBUG(" SP:", C[chan].volSP);
-          // still in ATTACK, just set the volume to the new level
-          setCVolume(chan, C[chan].volCV + C[chan].volumeStep);
-          C[chan].timeBase += C[chan].timeStep;
+          if (C[chan].state == ATTACK)
+          {
+            int8_t volEnd = (C[chan].volSP - C[chan].adsr->deltaVs < 0) ? 0 : (C[chan].volSP - C[chan].adsr->deltaVs);
+
+            startPhase(chan, C[chan].timeBase, C[chan].adsr->Td, volEnd);
+            DEBUGS("\n->ATTACK to DECAY");
+            C[chan].state = DECAY;
+          }
+          else if (C[chan].state == DECAY)
+          {
+            DEBUG("\n->DECAY to SUSTAIN: duration ", C[chan].duration);
+            C[chan].state = SUSTAIN;
+          }
+          else
+          {
+            DEBUGS("\n->RELEASE to IDLE");
+            C[chan].volCV = VOL_OFF;
+            C[chan].state = IDLE;
+          }
         }
       }
-    }
-    break;
 
-    case DECAY:
-    {
-      // check if enough time has passed to do something
-      if (millis() - C[chan].timeBase >= C[chan].timeStep)
+      // write the new volume
+      if (C[chan].volCV != v)
       {
-        int8_t volEnd = (C[chan].volSP - C[chan].adsr->deltaVs < 0) ? 0 : (C[chan].volSP - C[chan].adsr->deltaVs);
+        uint8_t vol = C[chan].volCV;
 
-        // if the current level was the end of the interval
-        if (C[chan].volCV == volEnd)
-        {
-          C[chan].timeBase = millis();
-          C[chan].state = SUSTAIN;
-          DEBUG("\n->DECAY to SUSTAIN: duration ", C[chan].duration);
-        }
-        else
-        {
-          DEBUG("\n--DECAY Volume delta ", C[chan].volumeStep);
-          // still in DECAY, just set the volume to the new level
-          setCVolume(chan, C[chan].volCV + C[chan].volumeStep);
-          C[chan].timeBase += C[chan].timeStep;
-        }
+        C[chan].volCV = v;
+        setCVolume(chan, vol);
       }
     }
     break;
@@ -297,8 +405,21 @@ void MD_SN76489::play(void)
       // do nothing but keep playing the same note at current volume
       if (C[chan].duration != 0)
       {
-        if (millis() - C[chan].timeBase >= C[chan].duration)
-          C[chan].state = C[chan].playTone ? IDLE : NOTE_OFF;
+        if (now - C[chan].timeBase >= C[chan].duration * SN_TIME_SCALE)
+        {
+          if (C[chan].playTone)
+          {
+            setCVolume(chan, VOL_OFF);
+            C[chan].state = IDLE;
+          }
+          else
+          {
+            // release from the time the sustain ended
+            startPhase(chan, C[chan].timeBase + (C[chan].duration * SN_TIME_SCALE), C[chan].adsr->Tr, C[chan].adsr->invert ? C[chan].volSP : 0);
+            DEBUGS("\n->SUSTAIN to RELEASE");
+            C[chan].state = RELEASE;
+          }
+        }
       }
     }
     break;
@@ -306,49 +427,122 @@ void MD_SN76489::play(void)
     case NOTE_OFF:
     {
       DEBUGS("\n->NOTE_OFF");
-      // set timing parameters for RELEASE phase
-      C[chan].timeBase = millis();
-      C[chan].timeStep = C[chan].adsr->Tr / (C[chan].volSP - C[chan].adsr->deltaVs);
-
-      // volume step direction remains the same as for previous DECAY
-      // but we set this explicitly as NOTE_OFF can happen anytime,
-      // before we finish ATTACK and timeStep is actually set.
-      C[chan].volumeStep = C[chan].adsr->invert ? 1 : -1;
+      // set timing parameters for RELEASE phase. NOTE_OFF can happen
+      // anytime, so the release starts from the current volume.
+      startPhase(chan, now, C[chan].adsr->Tr, C[chan].adsr->invert ? C[chan].volSP : 0);
 
       DEBUGS("\n->NOTE_OFF to RELEASE");
       C[chan].state = RELEASE;
     }
     break;
 
-    case RELEASE:
-    {
-      // check if enough time has passed to do something
-      if (millis() - C[chan].timeBase >= C[chan].timeStep)
-      {
-        // if the current level was the end of the interval
-        if ((!C[chan].adsr->invert && C[chan].volCV == 0) ||
-            (C[chan].adsr->invert && C[chan].volCV == C[chan].volSP))
-        {
-          DEBUGS("\n->RELEASE to IDLE");
-          setCVolume(chan, VOL_OFF);
-          C[chan].state = IDLE;
-        }
-        else
-        {
-          DEBUG("\n--RELEASE Volume delta ", C[chan].volumeStep);
-          // still in RELEASE, just set the volume to the new level
-          setCVolume(chan, C[chan].volCV + C[chan].volumeStep);
-          C[chan].timeBase += C[chan].timeStep;
-        }
-      }
+    default:
+      C[chan].state = IDLE;
+      break;
     }
-    break;
+  }
+}
+
+void MD_SN76489::startPhase(uint8_t chan, uint32_t now, uint16_t t, uint8_t volEnd)
+// Set up the timing to step the volume from the current level to volEnd 
+// in t ms. The time for each of the n volume steps is t/n ms, worked out 
+// as 16.16 fixed point by multiplying with 2^24/n from a table, rounded 
+// up so that the n steps always add up to t ms. The multiply is split 
+// into 16 bit parts to avoid 64 bit arithmetic.
+{
+  // 2^24/n rounded up, for n = 1 to VOL_MAX
+  static const uint32_t PROGMEM recip[VOL_MAX + 1] =
+  {
+    0, 16777216, 8388608, 5592406, 4194304, 3355444, 2796203, 2396746,
+    2097152, 1864136, 1677722, 1525202, 1398102, 1290556, 1198373, 1118482
+  };
+  uint8_t n;
+
+  if (volEnd > C[chan].volCV)
+  {
+    n = volEnd - C[chan].volCV;
+    C[chan].volumeStep = 1;
+  }
+  else
+  {
+    n = C[chan].volCV - volEnd;
+    C[chan].volumeStep = -1;
+  }
+
+  C[chan].volEnd = volEnd;
+  C[chan].timeBase = now;
+  C[chan].timeAcc = 0;
+  C[chan].timeStep = 0;     // no steps, phase ends immediately
+  if (n != 0)
+  {
+    uint32_t r = pgm_read_dword(&recip[n]);
+
+    C[chan].timeStep = (((uint32_t)t * (r >> 16)) << 8) + (((uint32_t)t * (r & 0xffff) + 0xff) >> 8);
+  }
+}
+
+uint32_t MD_SN76489::nextEventMs(uint32_t now)
+{
+  uint32_t next = NO_EVENT;
+
+#if SN_TIMER_PLAY
+  // the timer interrupt is running the envelopes
+  if (_timerObj == this)
+    return(next);
+#endif
+
+  for (uint8_t chan = 0; chan < MAX_CHANNELS && next != 0; chan++)
+  {
+    uint32_t t = NO_EVENT;
+
+    switch (C[chan].state)
+    {
+    case IDLE:      // nothing to do unless the volume still needs to be turned off
+      if (C[chan].volCV != VOL_OFF)
+        t = 0;
+      break;
+
+    case NOTE_ON:   // waiting for play() to start or stop a note
+    case TONE_ON:
+    case NOISE_ON:
+    case NOTE_OFF:
+      t = 0;
+      break;
+
+    case ATTACK:    // waiting for the next volume step
+    case DECAY:
+    case RELEASE:
+      t = stepTime(chan);
+      break;
+
+    case SUSTAIN:   // waiting for the duration to expire, if there is one
+      if (C[chan].duration != 0)
+        t = C[chan].duration * SN_TIME_SCALE;
+      break;
 
     default:
-      C[chan].state = IDLE;
+      t = 0;
       break;
     }
+
+    // convert the interval to time remaining from now
+    if (t != 0 && t != NO_EVENT)
+    {
+      uint32_t elapsed = now - C[chan].timeBase;
+
+      t = (elapsed >= t) ? 0 : t - elapsed;
+    }
+
+    if (t < next)
+      next = t;
   }
+
+  // library time units to ms, rounded up so that play() has something to 
+  // do when it is called. play() catches up if the event is run late.
+  if (next != NO_EVENT)
+    next = (next / SN_TIME_SCALE) + ((next % SN_TIME_SCALE) != 0 ? 1 : 0);
+
+  return(next);
 }
 
 uint8_t MD_SN76489::saneVolume(uint8_t v)
@@ -371,7 +565,13 @@ void MD_SN76489::setCVolume(uint8_t chan, uint8_t v)
   v = saneVolume(v);
   uint8_t cmd = LATCH_CMD | (chan << 5) | TYPE_VOL | ((0xf - v) & DATA1_MASK);
   DEBUGX(" : 0x", cmd);
-  send(cmd);
+  if (_regs.isChanged(cmd))   // the IC latch only moves if the byte is sent
+  {
+    _regs.decode(cmd);
+    send(cmd);
+  }
+  else
+    _suppressed++;
   C[chan].volCV = v;
 }
 
@@ -383,8 +583,10 @@ void MD_SN76489::setVolume(uint8_t chan, uint8_t v)
   if (chan < MAX_CHANNELS)
   {
     v = saneVolume(v);
+    SN_LOCK();
     setCVolume(chan, v);
     C[chan].volSP = v;
+    SN_UNLOCK();
   }
 }
 
@@ -395,20 +597,89 @@ void MD_SN76489::setVolume(uint8_t v)
     setVolume(i, v);
 }
 
+uint16_t MD_SN76489::freqToDivider(uint16_t freq)
+// Work out the tone divider clock/(32*freq) for a frequency. Rather than 
+// a 32 bit divide, the clock is multiplied by the reciprocal of freq. The
+// reciprocal is looked up using the top 7 bits of freq and one Newton-
+// Raphson step squares the error, so the estimate is at most 1 out and 
+// is corrected by comparing products.
+{
+  // frequencies outside the range of the IC
+  if (freq < _freqMin) return(DIVIDER_MAX);
+  if (freq > _clockK) return(1);
+
+  // normalize freq to [0x8000..0xffff]
+  uint16_t m = freq;
+  uint8_t sh = 0;
+
+  while (!(m & 0x8000))
+  {
+    m <<= 1;
+    sh++;
+  }
+
+  // r = 2^31/m from the table then r = r * (2 - m*r/2^31)
+  uint32_t r = pgm_read_word(&recipTable[(m >> 9) & 0x3f]);
+  int32_t e = (int32_t)((1UL << 31) - (m * r));
+
+  r += ((int32_t)r * (e >> 16)) >> 15;
+
+  // divider = clock/32 * 2^sh/m, then make it exact
+  uint16_t n = ((uint32_t)_clockKn * r) >> (31 - sh - _clockKsh);
+
+  while ((uint32_t)n * freq > _clockK)
+    n--;
+  while ((uint32_t)(n + 1) * freq <= _clockK)
+    n++;
+
+  return(n);
+}
+
 void MD_SN76489::setFrequency(uint8_t chan, uint16_t freq)
 // Calculate register values and set them
 {
   DEBUG("\nsetFrequency C", chan);
   DEBUG(" F", freq);
 
+  setDivider(chan, freqToDivider(freq));
+}
+
+void MD_SN76489::setDivider(uint8_t chan, uint16_t n)
+// Set the tone divider register values
+{
+  DEBUG("\nsetDivider C", chan);
+  DEBUGX(" : 0x", n);
+
   if (chan < MAX_CHANNELS - 1)    // last channel only does noise
   {
-    uint16_t n = CLOCK_HZ / ((uint32_t)freq << 5);  // <<5 same as *32
+    // Send frequency data in two parts of the frequency, skipping
+    // the parts that are already set in the IC register
+    uint8_t reg = chan << 1;
+    uint8_t cmd[2];
+
+    cmd[0] = LATCH_CMD | (chan << 5) | TYPE_TONE | (n & DATA1_MASK);
+    cmd[1] = DATA_CMD | ((n >> 4) & DATA2_MASK);
 
-    DEBUGX(" : 0x", n);
-    // Send frequency data in two parts of the frequency
-    send(LATCH_CMD | (chan << 5) | TYPE_TONE | (n & DATA1_MASK));
-    send(DATA_CMD | ((n >> 4) & DATA2_MASK));
+    SN_LOCK();
+    if (_regs.isKnown(reg) && ((_regs.get(reg) >> 4) == ((n >> 4) & DATA2_MASK)))
+    {
+      // only the lower 4 bits can be different
+      if (_regs.isChanged(cmd[0]))
+      {
+        _regs.decode(cmd[0]);
+        send(cmd[0]);
+      }
+      else
+        _suppressed++;
+      _suppressed++;
+    }
+    else
+    {
+      _regs.decode(cmd[0]);
+      _regs.decode(cmd[1]);
+      sendBurst(cmd, ARRAY_SIZE(cmd));
+    }
+    SN_UNLOCK();
   }
 }
 
@@ -416,16 +687,192 @@ void MD_SN76489::setNoise(noiseType_t noise)
 // Set the noise channel parameters
 {
   if (noise != NOISE_OFF)
-    send(LATCH_CMD | (NOISE_CHANNEL << 5) | noise);
+  {
+    uint8_t cmd = LATCH_CMD | (NOISE_CHANNEL << 5) | noise;
+
+    // always sent, as every write to the noise register resets the noise
+    // shift register and restarts the noise
+    SN_LOCK();
+    _regs.decode(cmd);
+    send(cmd);
+    SN_UNLOCK();
+  }
   else
     setVolume(NOISE_CHANNEL, 0);
 }
 
+void MD_SN76489::write(const uint8_t* data, size_t len)
+// Write a buffer of bytes to the device, keeping the shadow registers in step
+{
+  SN_LOCK();
+  for (size_t i = 0; i < len; i++)
+    _regs.decode(data[i]);
+
+  sendBurst(data, len);
+  SN_UNLOCK();
+}
+
+#if SN_QUEUE_SIZE
+uint8_t MD_SN76489::getQueueCount(void)
+{
+  return((_qHead - _qTail) & (SN_QUEUE_SIZE * 2 - 1));
+}
+
+bool MD_SN76489::queue(uint8_t data, uint32_t t)
+{
+  return(queue(&data, 1, t));
+}
+
+bool MD_SN76489::queue(const uint8_t* data, size_t len, uint32_t t)
+// Head and tail indices run over twice the queue size so that a full 
+// queue can be told apart from an empty one. Only queue() changes the
+// head and only poll() changes the tail.
+{
+  uint8_t count = getQueueCount();
+
+  if (count + len > SN_QUEUE_SIZE)
+  {
+    DEBUGS("\nqueue overflow");
+    _qOverflow += len;
+    return(false);
+  }
+
+  uint8_t head = _qHead;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    _q[head & (SN_QUEUE_SIZE - 1)].time = t;
+    _q[head & (SN_QUEUE_SIZE - 1)].data = data[i];
+    head = (head + 1) & (SN_QUEUE_SIZE * 2 - 1);
+  }
+  asm volatile("" ::: "memory");  // entries stored before the head is moved
+  _qHead = head;    // entries now visible to poll()
+
+  count += len;
+  if (count > _qHighWater)
+    _qHighWater = count;
+
+  return(true);
+}
+
+void MD_SN76489::poll(uint32_t now)
+{
+  uint8_t buf[SN_QUEUE_SIZE];
+  uint8_t len = 0;
+  uint8_t tail = _qTail;
+
+  // discard the entries cleared by clearQueue(), unless already sent
+  if (_qClear)
+  {
+    _qClear = false;
+    uint8_t clearTo = _qClearTo;
+
+    if (((clearTo - tail) & (SN_QUEUE_SIZE * 2 - 1)) <= ((_qHead - tail) & (SN_QUEUE_SIZE * 2 - 1)))
+      tail = clearTo;
+  }
+
+  // collect all the bytes that are due ...
+  while (tail != _qHead && (int32_t)(now - _q[tail & (SN_QUEUE_SIZE - 1)].time) >= 0)
+  {
+    buf[len++] = _q[tail & (SN_QUEUE_SIZE - 1)].data;
+    tail = (tail + 1) & (SN_QUEUE_SIZE * 2 - 1);
+  }
+  _qTail = tail;
+
+  // ... and send them together
+  if (len != 0)
+    write(buf, len);
+}
+
+void MD_SN76489::clearQueue(void)
+// the tail is only changed by poll(), so ask poll() to move it
+{
+  _qClearTo = _qHead;
+  _qClear = true;
+}
+#endif
+
 void MD_SN76489::send(uint8_t data)
 {
+  (void)data;   // only used by DEBUGX()
   DEBUGX("\nVIRTUAL send of byte 0x", data);
 }
 
+void MD_SN76489::sendBurst(const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    send(data[i]);
+}
+
+void MD_SN76489::writeWait(uint8_t rdy, uint8_t writeUs)
+{
+  if (rdy == NO_PIN)
+    delayMicroseconds(writeUs);
+  else
+  {
+    // READY is pulled low by the IC while it loads the data and 
+    // released once done. Allow twice the nominal time before giving up.
+    uint32_t timeStart = micros();
+
+    while (digitalRead(rdy) == LOW && (micros() - timeStart < 2 * writeUs))
+      ;  // wait
+  }
+}
+
+#if SN_TIMER_PLAY
+MD_SN76489* volatile MD_SN76489::_timerObj = nullptr;
+
+// The envelope timer is set to Clear Timer on Compare (CTC) mode with a
+// prescaler of 64 and interrupts on compare match A at 1kHz.
+#define TIMER_HZ  1000
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define TIMER_START() { TCCR1A = 0; TCNT1 = 0; OCR1A = (F_CPU / 64 / TIMER_HZ) - 1; TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10); TIMSK1 |= _BV(OCIE1A); }
+#define TIMER_STOP()  { TIMSK1 &= ~_BV(OCIE1A); TCCR1B = 0; }
+ISR(TIMER1_COMPA_vect) { MD_SN76489::timerISR(); }
+#elif defined(__AVR_ATmega32U4__)
+// Timer1 is used for the clock signal on Teensy 2.0
+#define TIMER_START() { TCCR3A = 0; TCNT3 = 0; OCR3A = (F_CPU / 64 / TIMER_HZ) - 1; TCCR3B = _BV(WGM32) | _BV(CS31) | _BV(CS30); TIMSK3 |= _BV(OCIE3A); }
+#define TIMER_STOP()  { TIMSK3 &= ~_BV(OCIE3A); TCCR3B = 0; }
+ISR(TIMER3_COMPA_vect) { MD_SN76489::timerISR(); }
+#endif
+
+bool MD_SN76489::setTimerPlay(bool enable)
+// HARDWARE DEPENDENT CODE!!
+{
+#ifdef TIMER_START
+  bool b = false;
+
+  SN_LOCK();
+  if (enable && _timerObj == nullptr)
+  {
+    _timerObj = this;
+    timerPlayStart();
+    TIMER_START();
+    b = true;
+  }
+  else if (!enable && _timerObj == this)
+  {
+    TIMER_STOP();
+    _timerObj = nullptr;
+    b = true;
+  }
+  SN_UNLOCK();
+
+  return(b);
+#else
+  #warning ENVELOPE TIMER UNDEFINED FOR THIS MCU ARCHITECTURE
+  (void)enable;
+  return(false);
+#endif
+}
+
+void MD_SN76489::timerISR(void)
+{
+  if (_timerObj != nullptr)
+    _timerObj->runFSM(SN_TIME_NOW());
+}
+#endif
+
 void MD_SN76489::startClock(void)
 // HARDWARE DEPENDENT CODE!!
 {
@@ -518,7 +965,7 @@ void MD_SN76489::startClock(void)
   // Teensy++ 1.0 and 2.0
 #endif
 
-#ifndef _STARTCLOCK_
+#if !defined(_STARTCLOCK_) && defined(ARDUINO)
   #warning 4MHz CLOCK GENERATION UNDEFINED FOR THIS MCU ARCHITECTURE
 #endif
 }
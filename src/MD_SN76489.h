@@ -1,6 +1,11 @@
 #pragma once
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#include <SPI.h>
+#else
+#include "MD_SN76489_Host.h"
+#endif
 
 /**
  * \file
@@ -37,6 +42,7 @@ Topics
 - \subpage pageHardware
 - \subpage pageLibrary
 - \subpage pageADSR
+- \subpage pageVGM
 - \subpage pageCompileSwitch
 - \subpage pageRevisionHistory
 - \subpage pageCopyright
@@ -48,6 +54,34 @@ References
 - Additional technical information from http://www.smspower.org/Development/SN76489
 
 \page pageRevisionHistory Revision History
+Oct 2026 version 1.2.0
+- Added direct port I/O fast path for MD_SN76489_Direct::send()
+- Added MD_SN76489_Benchmark example
+- Added hardware SPI transport mode and burst transfers to MD_SN76489_SPI
+- Added optional READY pin handshake, write stall now derived from the IC clock
+- Added MD_SN76489_Regs register model and shadow cache to suppress redundant writes
+- Added write() method for a buffer of bytes and sendBurst() override for MD_SN76489_Direct
+- Added timed write queue with queue() and poll() methods
+- Added MD_SN76489_Emu software emulation of the IC and host build support
+- Added MD_SN76489_Emu block render() with SSE2 kernel and MD_SN76489_EmuBench tool
+- Added MD_SN76489_Emu band limited (BLEP) rendering mode
+- Added play(uint32_t) method to run envelopes from an application time source
+- Added nextEventMs() method to find when play() next needs to run
+- Added optional timer interrupt driven envelopes with setTimerPlay()
+- ADSR volume steps timed with fixed point arithmetic, phases now take the specified time
+- Added SN_TIME_US compile switch for microsecond envelope timing
+- Added noteMidi() and setDivider() methods, SN_CLOCK_HZ compile switch
+- Added begin(clockHz) to set the IC clock at run time, tone dividers worked out without a divide
+- Added MD_SN76489_T template with compile time pin transports, Direct and SPI classes now use it
+- Added MD_SN76489_VGM class to play VGM files without blocking
+- Added MD_SN76489_VGMBlockSource double buffered block reads for VGM files
+- Added MD_SN76489_VGMMemory to play VGM data in place from PROGMEM or memory, vgm2h tool and VGM_Flash example
+- Added MD_SN76489_VGZSource to play gzip compressed VGM files and MD_SN76489_VGZBench tool
+- Added VGM loop points, seek() with a checkpoint index and seek() for the VGM sources
+- Added compact stream (.sns) file format to MD_SN76489_VGM and MD_SN76489_VGMToSNS converter tool
+- Added MD_SN76489_VGMOpt tool to strip redundant writes and merge waits in VGM files
+- Added MD_SN76489_VGMRecorder to record the writes to any MD_SN76489 object as a VGM file
+
 Jan 2020 version 1.1.1
 - Fixed channel 2 exclusion in setFrequency()
 
@@ -91,7 +125,13 @@ The IC has 16 pins with the following pinout:
 |AUD    |Audio output (headphone jack)
 |CLK    |4MHz clock signal (see below)
 |/CE    |Active low Chip Enable (connect to GND or MCU output if more than one IC shares D0-D7)
-|RDY    |Ready signal (unused).
+|RDY    |Ready signal output (optional, open collector).
+
+The IC takes 32 clock cycles to load the data presented on D0-D7 while 
+/WE is low. If the RDY pin is connected to the MCU (with a pull-up resistor
+or using the MCU internal pull-up) the library ends the write as soon as the 
+IC signals it is ready. If RDY is not connected, /WE is held low for the 
+number of microseconds for 32 cycles of the IC clock.
 
 Note: If multiple ICs are interfaced, then the ICs CE line must also be used
 to select the right device and share the data lines. This is not managed
@@ -133,6 +173,19 @@ clock signal must be provided.
 If an external hardware clock is used, then the library can be prevented from
 starting the MCU clock in the class initialization parameters.
 
+External clocks are not always 4MHz - many boards and most VGM music files 
+use the 3.579545MHz NTSC colorburst clock. The frequency of the external clock 
+is passed to begin(clockHz), otherwise the SN_CLOCK_HZ default is assumed (see 
+\ref pageCompileSwitch). All the tone dividers, the IC write time and the 
+emulated IC are worked out for this clock.
+
+To avoid a 32 bit divide each time a frequency is set, the tone divider 
+clock/(32*f) is worked out by multiplying with the reciprocal of f. The 
+reciprocal is read from a small table using the top bits of f, refined with 
+one Newton-Raphson step and the divider is then corrected to the exact 
+result. Frequencies outside the range of the IC are limited to the lowest or 
+highest divider [1..1023].
+
 Hardware Direct Connection to the MCU
 -------------------------------------
 The derived class SN_SN76489_Direct uses 8 digital output data lines 
@@ -144,6 +197,12 @@ object initialization parameters. The D array parameter has pin numbers
 arranged to correspond to the IC pins (ie, pin D[0] is connected to IC 
 pin D0, D[1] to D1, etc). The WE pin can be any arbitrary pin.
 
+When SN_FAST_IO is enabled (see \ref pageCompileSwitch) the port and bit 
+mask for each data pin are worked out once in begin() and send() writes 
+each MCU port used by D0-D7 with a single store. Wiring all the data pins 
+to the same port is the fastest option and, if D[0] to D[7] map to port 
+bits 7 to 0 in that order, the data byte is written unchanged to the port.
+
 Connections between the MCU and SN76489 are mapped as shown below.
 The Arduino pins are arbitrary except the 4Mhz clock - the pins shown are 
 used in the library examples.
@@ -159,6 +218,7 @@ used in the library examples.
 | D6   [ 6]   | D6    [11]             |
 | D7   [ 7]   | D7    [10]             |
 | WE   [ 8]   | /WE   [ 5]             |
+| RDY  [ 9]   | RDY   [ 4] (optional)  |
 | 4Mhz [ 3]   | CLK   [14]             |
 |             | /OE   [ 6] (GND)       |
 |             | AUDIO [ 7] (Amplifier) |
@@ -175,6 +235,12 @@ This uses less pins than a direct connection but requires an additional
 IC. The pins used are arbitrary and specified by the application as part
 of the object initialization parameters.
 
+Alternatively, the MCU hardware SPI peripheral can be used to clock the data
+into the 74595 buffer. In this case DAT and CLK must be connected to the
+MCU MOSI and SCK pins, and the SPI clock frequency is specified in the object
+initialization parameters. Multiple bytes (eg, the latch and data bytes of a
+frequency update) are sent within a single SPI transaction.
+
 Connections between the MCU, 74595 and SN76489 are mapped as shown below.
 The Arduino pins are arbitrary except the 4Mhz clock - the pins shown are 
 used in the library examples.
@@ -195,6 +261,7 @@ used in the library examples.
 |             | /OE [13] (GND) |                        |
 |             | /MR [10] (+5V) |                        |
 | WE    [ 8]  |                | /WE   [ 5]             |
+| RDY   [ 9]  |                | RDY   [ 4] (optional)  |
 | 4Mhz  [ 3]  |                | CLK   [14]             |
 |             |                | /OE   [ 6] (GND)       |
 |             |                | AUDIO [ 7] (Amplifier) |
@@ -207,12 +274,66 @@ an amplifier.
 
 ![SN76489 Audio Output] (SN76489_Audio_Out.png "SN76489 Audio Output")
 
+Software Emulation
+------------------
+The derived class MD_SN76489_Emu does not use any hardware. Bytes sent to 
+the 'device' are decoded into a software model of the IC registers, and the 
+three tone generators, the noise generator and the attenuators are emulated
+to produce signed 16 bit PCM audio samples at a sample rate set by the 
+application. 
+
+The noise shift register can be configured as the 15 bit register of the TI 
+SN76489 or the 16 bit variant used in the SEGA consoles.
+
+Samples are rendered one at a time with getSample() or in blocks with render().
+As the IC registers cannot change during a call to render(), the channel periods
+and volumes are worked out once per block and all 4 channel counters are counted
+down together. If SN_EMU_SIMD is enabled (see \ref pageCompileSwitch), the 4 
+counters are held in one SSE2 vector register. For best performance render the 
+audio in blocks between each group of register writes.
+
+The tone generators run at up to 125kHz, so rendering the square waves directly 
+at an audio sample rate produces aliasing (inharmonic tones) that is clearly 
+audible for higher notes. If SN_EMU_BLEP is enabled (see \ref pageCompileSwitch),
+setBandLimited() switches the emulator to band limited step (BLEP) synthesis. 
+The time of each output transition of the tone and noise channels is worked out 
+to a fraction of a sample, and a band limited step is added into an accumulation 
+buffer from a precomputed windowed sinc kernel table. The buffer is integrated 
+to produce the output samples. The cost depends on the number of transitions rather 
+than on the IC clock rate, so the aliasing is removed for a small fraction of the 
+cost of rendering at a high sample rate and filtering down. BLEP output is delayed 
+by 15 samples and can overshoot the square wave level, so is limited to the int16_t 
+range.
+
+Host Builds
+-----------
+When the library is not compiled by the Arduino build system (ie, ARDUINO 
+is not defined) the header file MD_SN76489_Host.h provides replacements for 
+the Arduino functions used by the library. The library can then be built and 
+run on a host computer with a standard C++ compiler, where MD_SN76489_Emu is 
+a target for testing, benchmarking and rendering audio. On the host build, 
+the hardware I/O functions do nothing and time is taken from the host clock.
+
 \page pageLibrary Using the Library
 Defining the object
 -------------------
 The object definition include a list of all the I/O pins that are used
 to connect the MCU to the SN76489 IC.
 
+MD_SN76489_Direct and MD_SN76489_SPI keep the pin numbers in the object and
+send the data to the IC through virtual methods. Where the pins are fixed in 
+the hardware design, the MD_SN76489_T template can be used with the pins as 
+template parameters instead
+
+    MD_SN76489_T<MD_SN76489_DirectPins<A0, A1, A2, A3, 4, 5, 6, 7, 8>> S(true);
+    MD_SN76489_T<MD_SN76489_SPIPins<10, 8>> S(true);
+
+The write() methods of the template send the data straight to the transport,
+so the compiler can inline the whole write path and, on the ATmega328P, each 
+pin write becomes a single instruction. This is most useful where large 
+numbers of bytes are written with write() (eg, playing VGM music). The other 
+library methods work in the same way for both types of object. 
+
 setup()
 -------
 The setup() function must include the begin() method. All the I/O pins are
@@ -226,6 +347,76 @@ play() every iteration through loop(). The play() method executes very quickly
 if the library has nothing to process, imposing minimal overheads on the user
 application.
 
+play() takes the time from millis() (or micros(), see \ref pageADSR). The 
+application can supply its own time by calling play(now) instead, and all the 
+envelope and note duration timing will follow the time supplied. Stepping this 
+'virtual clock' together with the render() method of MD_SN76489_Emu allows music
+to be rendered much faster than real time, with identical results on every run.
+
+Rather than calling play() continuously, the application can use nextEventMs() to 
+find out how long it can sleep or do other work before play() next has something 
+to do. NO_EVENT is returned when all the channels are idle or are sustaining notes 
+until they are turned off by the application.
+
+Timer Driven Envelopes
+----------------------
+When play() is called from loop(), the timing of the envelopes depends on how 
+long the rest of loop() takes. Long Serial or SD card operations will stretch
+the envelopes and note durations. If SN_TIMER_PLAY is enabled (see \ref pageCompileSwitch),
+setTimerPlay() hands the envelopes over to a 1kHz timer interrupt set up by the 
+library, and envelope timing is then independent of the application. While the 
+timer is running play() does nothing and nextEventMs() returns NO_EVENT.
+
+The timer used depends on the MCU, as the clock generation may already use a 
+timer:
+- ATmega328P, ATmega168, ATmega1280, ATmega2560 use Timer1.
+- ATmega32U4 uses Timer3.
+
+Only one object can be driven by the timer at any time. Library methods that 
+change the channel data or write to the IC lock out the timer interrupt while 
+they run, so that they cannot be interleaved with writes from the interrupt. 
+Note that other libraries using the same timer (eg, Servo) cannot be used at the 
+same time.
+
+With hardware SPI (MD_SN76489_SPI or MD_SN76489_SPIPins), setTimerPlay() calls 
+SPI.usingInterrupt() so that SPI transactions for other devices on the same bus 
+(eg, an SD card holding VGM files) hold off the timer interrupt until they are 
+complete. On the AVR this masks all interrupts during those transactions.
+
+Register Shadow Cache
+---------------------
+The library keeps a copy of the 8 SN76489 registers (4 attenuators, 3 tone 
+dividers and the noise control) as they were last written to the IC. Volume 
+and frequency settings that would write the value already held in the 
+register are not sent to the IC, and a tone divider update where the upper 6 
+bits are unchanged is sent as a single latch byte. The number of bytes saved 
+is returned by getSuppressedWrites(). Noise settings are always sent, as each
+write to the noise register resets the noise shift register.
+
+Bytes sent using write() are always sent to the IC and update the copy of the
+registers. If the IC is reset outside of the library's control, invalidateRegs()
+will force the next setting of each register to be written to the IC.
+
+Timed Write Queue
+-----------------
+Register writes can be queued ahead of time, each with the micros() time at
+which it should be sent to the IC, using the queue() methods. The queued bytes
+are sent by poll() when their time arrives. poll() must be called frequently, 
+either from loop() or from a timer interrupt set up by the application, so that 
+output timing is not affected by other processing (eg, SD card or Serial I/O) 
+done when the data is queued.
+
+Bytes must be queued in time order, as poll() sends them in the same order they
+were queued. The queue holds SN_QUEUE_SIZE bytes. Bytes that do not fit are
+rejected and counted, and the maximum number of bytes held in the queue is 
+tracked to help size the queue for an application.
+
+If poll() is called from an interrupt, the application must not send data to
+the IC from other code while the queue is not empty. queue() and clearQueue()
+only change the head of the queue and poll() only changes the tail, so they
+can be called from different contexts. clearQueue() asks the next poll() to 
+discard the bytes queued so far.
+
 Playing a Note
 --------------
 A note starts with the __note on__ event and ends with a __note off__ event.
@@ -284,7 +475,17 @@ envelope parameters. The nomenclature for the parameters follows the labels and
 above. A flag can be set to invert the specified envelope.
 
 The SN74689 volume controls are limited to 15 steps, so the Attack, Decay or Release phases
-are implemented as a linear progression changing the sound volume over time.
+are implemented as a linear progression changing the sound volume over time. 
+The time between volume steps is kept to a fraction of a millisecond, so each 
+phase takes the specified time irrespective of the number of volume steps. A 
+phase with no volume steps (eg, Decay with a Vs of 0) ends immediately. If 
+play() is called less often than the time between steps, all the steps that are 
+due are done together.
+
+Envelope times are specified in milliseconds and by default are timed using 
+millis(), so each volume step can be up to 1ms late. For short (percussive) 
+envelopes with steps less than a few milliseconds apart, SN_TIME_US can be enabled
+(see \ref pageCompileSwitch) to time the envelopes using micros().
 
 \page pageCompileSwitch Compiler Switches
 
@@ -293,6 +494,76 @@ LIBDEBUG
 Controls debugging output to the serial monitor from the library. If set to
 1 debugging is enabled and the main program must open the Serial port for output
 
+SN_FAST_IO
+----------
+Controls whether MD_SN76489_Direct writes the data and WE pins using the MCU 
+port registers instead of digitalWrite(). This is enabled by default for AVR 
+architectures and can be set to 0 to force the use of the portable Arduino I/O 
+functions.
+
+SN_QUEUE_SIZE
+-------------
+Sets the number of bytes held in the timed write queue. This must be a power
+of 2 no larger than 128. Each entry uses 5 bytes of RAM. Set to 0 to remove 
+the queue from the library.
+
+SN_CLOCK_HZ
+-----------
+The default frequency in Hz of the clock signal supplied to the IC, by default 
+4MHz. This is used to work out the tone dividers, the IC write time and the 
+emulated IC clock unless a different clock is set with begin(clockHz). The MIDI
+note table used by noteMidi() is worked out by the compiler for this clock, so
+noteMidi() is fastest if this is the clock actually used. The clock generated by 
+the MCU (see \ref pageHardware) is always 4MHz.
+
+SN_TIME_US
+----------
+Set to 1 to time the ADSR envelopes and note durations in microseconds using 
+micros() instead of milliseconds using millis(). The time passed to play(uint32_t)
+and nextEventMs(uint32_t) is then in microseconds. Envelope times and note 
+durations are still specified in milliseconds. As micros() wraps around after 
+about 71 minutes, note durations must be shorter than this.
+
+SN_VGM_BLOCK
+------------
+Sets the size in bytes of each of the two buffers used by MD_SN76489_VGMBlockSource
+to read VGM files (see \ref pageVGM). The default of 512 is one SD card sector,
+so each read is of a whole sector. Smaller blocks save RAM, at the cost of 
+more file reads. On the ATmega328P and ATmega168 the default is 128, as two 
+512 byte buffers and the SD card library sector buffer do not fit in 2kB of
+RAM together.
+
+SN_VGZ_WINDOW
+-------------
+Sets the size in bytes of the history window used by MD_SN76489_VGZSource to 
+decompress .vgz files (see \ref pageVGM). This must be a power of 2, at least
+twice SN_VGM_BLOCK and no more than 32768. The default is 32768, the largest 
+window gzip uses, so that every file can be played. On the AVR the default
+is 1024, which only plays files that are very small or compress poorly.
+
+SN_TIMER_PLAY
+-------------
+Set to 1 to include the timer interrupt driven envelopes (setTimerPlay()) in
+the library. This is disabled by default as the library then defines the 
+interrupt handler for the timer, which will conflict with any other library 
+that uses the same timer. When the IC is connected through hardware SPI, the 
+timer interrupt is registered with SPI.usingInterrupt() so that it cannot 
+write to the IC during an SPI transaction for another device.
+
+SN_EMU_SIMD
+-----------
+Controls whether MD_SN76489_Emu::render() uses the SSE2 vector instructions to
+count down the 4 channel counters together. This is enabled by default when the 
+compiler targets a processor with SSE2 (eg, any x86-64 host) and can be set to 0 
+to use the portable scalar code.
+
+SN_EMU_BLEP
+-----------
+Controls whether the band limited rendering mode of MD_SN76489_Emu is compiled. 
+This needs a 4kByte kernel table and a 1.1kByte accumulation buffer for each 
+emulator object, so it is enabled by default only when not compiling for AVR 
+processors.
+
 \page pageDonation Support the Library
 If you like and use this library please consider making a small donation 
 using [PayPal](https://paypal.me/MajicDesigns/4USD)
@@ -318,6 +589,151 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 
 #define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))  ///< Standard method to work out array size
 
+#ifndef SN_FAST_IO
+#if defined(__AVR__)
+#define SN_FAST_IO 1  ///< Use port registers for MD_SN76489_Direct I/O. See \ref pageCompileSwitch
+#else
+#define SN_FAST_IO 0  ///< Use port registers for MD_SN76489_Direct I/O. See \ref pageCompileSwitch
+#endif
+#endif
+
+#ifndef SN_EMU_SIMD
+#if defined(__SSE2__)
+#define SN_EMU_SIMD 1 ///< Use SSE2 vector code in MD_SN76489_Emu::render(). See \ref pageCompileSwitch
+#else
+#define SN_EMU_SIMD 0 ///< Use SSE2 vector code in MD_SN76489_Emu::render(). See \ref pageCompileSwitch
+#endif
+#endif
+
+#ifndef SN_EMU_BLEP
+#if defined(__AVR__)
+#define SN_EMU_BLEP 0 ///< Include the band limited rendering mode in MD_SN76489_Emu. See \ref pageCompileSwitch
+#else
+#define SN_EMU_BLEP 1 ///< Include the band limited rendering mode in MD_SN76489_Emu. See \ref pageCompileSwitch
+#endif
+#endif
+
+#ifndef SN_QUEUE_SIZE
+#define SN_QUEUE_SIZE 16  ///< Number of bytes in the timed write queue. See \ref pageCompileSwitch
+#endif
+
+#ifndef SN_CLOCK_HZ
+#define SN_CLOCK_HZ 4000000UL ///< IC clock frequency in Hz. See \ref pageCompileSwitch
+#endif
+
+#ifndef SN_TIME_US
+#define SN_TIME_US 0      ///< Time envelopes in microseconds. See \ref pageCompileSwitch
+#endif
+
+#if SN_TIME_US
+#define SN_TIME_NOW()   micros()  ///< Library time source
+#define SN_TIME_SCALE   1000UL    ///< Library time units in 1 ms
+#else
+#define SN_TIME_NOW()   millis()  ///< Library time source
+#define SN_TIME_SCALE   1UL       ///< Library time units in 1 ms
+#endif
+
+#ifndef SN_TIMER_PLAY
+#define SN_TIMER_PLAY 0   ///< Include the timer interrupt driven envelopes. See \ref pageCompileSwitch
+#endif
+
+#if SN_TIMER_PLAY && defined(__AVR__)
+#define SN_LOCK()   uint8_t _sreg = SREG; cli() ///< Start of code that must not be interrupted by the envelope timer
+#define SN_UNLOCK() SREG = _sreg                ///< End of code that must not be interrupted by the envelope timer
+#else
+#define SN_LOCK()   ///< Start of code that must not be interrupted by the envelope timer
+#define SN_UNLOCK() ///< End of code that must not be interrupted by the envelope timer
+#endif
+
+/**
+ * Register model of the SN76489 IC
+ *
+ * Tracks the contents of the 8 IC registers by decoding the bytes written 
+ * to the device. Registers are numbered in the same order as the register 
+ * address bits in the latch byte (ie, channel * 2 + type):
+ * 
+ * | Reg | Contents          | Reg | Contents        |
+ * |-----|-------------------|-----|-----------------|
+ * |  0  | Channel 0 tone    |  1  | Channel 0 volume|
+ * |  2  | Channel 1 tone    |  3  | Channel 1 volume|
+ * |  4  | Channel 2 tone    |  5  | Channel 2 volume|
+ * |  6  | Noise control     |  7  | Channel 3 volume|
+ */
+class MD_SN76489_Regs
+{
+  public:
+    static const uint8_t REG_COUNT = 8;  ///< Number of registers in the IC
+    static const uint8_t NOISE_REG = 6;  ///< The noise control register
+
+   /**
+    * Reset the register model.
+    *
+    * All registers are marked as unknown and the latched register set to 0.
+    */
+    void reset(void);
+
+   /**
+    * Update the register model from a byte written to the IC.
+    *
+    * Latch bytes select the register and write its 4 lower bits. Data bytes
+    * write the upper 6 bits of a latched tone register, or the 4 lower bits 
+    * of other registers.
+    *
+    * \param data  the byte written to the IC.
+    * \return true if the register value changed or was previously unknown.
+    */
+    bool decode(uint8_t data);
+
+   /**
+    * Check if a byte would change the register model.
+    *
+    * Works out the same result as decode() without updating the model, so 
+    * a byte that is not going to be written to the IC leaves the model 
+    * (including the latched register) the same as the IC.
+    *
+    * \param data  the byte to be written to the IC.
+    * \return true if the register value would change or is unknown.
+    */
+    bool isChanged(uint8_t data) const;
+
+   /**
+    * Check if a register value is known.
+    *
+    * \param reg  the register number [0..REG_COUNT-1].
+    * \return true if all the bits of the register have been written since reset().
+    */
+    bool isKnown(uint8_t reg) const;
+
+   /**
+    * Get the current value of a register.
+    *
+    * \param reg  the register number [0..REG_COUNT-1].
+    * \return the 10 bit tone divider or the 4 bit register value.
+    */
+    inline uint16_t get(uint8_t reg) const { return(_reg[reg]); }
+
+   /**
+    * Get the currently latched register.
+    *
+    * \return the register number [0..REG_COUNT-1] for the last latch byte.
+    */
+    inline uint8_t getLatched(void) const { return(_latch); }
+
+   /**
+    * Check if a register is a tone divider.
+    *
+    * \param reg  the register number [0..REG_COUNT-1].
+    * \return true if the register holds a 10 bit tone divider.
+    */
+    static inline bool isTone(uint8_t reg) { return((reg & 1) == 0 && reg != NOISE_REG); }
+
+  private:
+    uint16_t _reg[REG_COUNT]; ///< register values
+    uint8_t _knownLo;         ///< bit per register set when the lower 4 bits are known
+    uint8_t _knownHi;         ///< bit per register set when the upper 6 bits of a tone register are known
+    uint8_t _latch;           ///< currently latched register
+};
+
 /**
  * Base class for the MD_SN76489 library
  */
@@ -328,6 +744,8 @@ class MD_SN76489
     static const uint8_t NOISE_CHANNEL = 3; ///< The channel for periodic/white noise
     static const uint8_t VOL_OFF = 0x0;     ///< Convenience constant for volume off
     static const uint8_t VOL_MAX = 0xf;     ///< Convenience constant for volume on
+    static const uint8_t NO_PIN = 0xff;     ///< Convenience constant for an unconnected pin
+    static const uint32_t NO_EVENT = 0xffffffff; ///< nextEventMs() value when nothing is scheduled
 
    /**
     * Noise type enumerated definitions
@@ -392,12 +810,48 @@ class MD_SN76489
     *
     */
     virtual void begin(void);
+
+   /**
+    * Initialize the object for a specified IC clock.
+    *
+    * Set the frequency of the clock signal supplied to the IC and then 
+    * initialize the object as for begin(). The clock frequency is used to work
+    * out the tone dividers for setFrequency(), note() and noteMidi(). 
+    *
+    * The clock generated by the MCU is always 4MHz, so this only needs to be 
+    * used with an external clock different from SN_CLOCK_HZ.
+    *
+    * \param clockHz the frequency in Hz of the IC clock signal.
+    */
+    void begin(uint32_t clockHz);
+
+   /**
+    * Get the IC clock frequency.
+    *
+    * \sa begin(uint32_t)
+    *
+    * \return the IC clock frequency in Hz used by the library.
+    */
+    inline uint32_t getClock(void) { return(_clockHz); }
     
    //--------------------------------------------------------------
    /** \name Hardware control basics.
     * @{
     */
 
+   /**
+    * Wait for the SN76489 IC to latch the data.
+    *
+    * Called by the transport classes while /WE is held low. If a READY pin 
+    * is specified, waits until the IC signals ready (with a timeout in case
+    * the pin is not working). Otherwise waits for the 32 IC clock cycles 
+    * needed to load the data.
+    *
+    * \param rdy     the READY pin number or NO_PIN if not connected
+    * \param writeUs microseconds for the IC to latch the data
+    */
+    static void writeWait(uint8_t rdy, uint8_t writeUs);
+
    /**
     * Set the volume for a channel.
     *
@@ -423,6 +877,8 @@ class MD_SN76489
     * Set the frequency for a channel.
     *
     * Set the frequency output for a channel to be the value specified.
+    * Frequencies outside the range of the IC are set to the lowest or
+    * highest frequency the IC can play.
     *
     * This method is not supported by the NOISE_CHANNEL.
     *
@@ -433,6 +889,22 @@ class MD_SN76489
     */
     void setFrequency(uint8_t chan, uint16_t freq);
 
+   /**
+    * Set the tone divider for a channel.
+    *
+    * Set the 10 bit tone divider register (N) for a channel. The frequency 
+    * output is the IC clock / (32 * N). This avoids working out the divider 
+    * from a frequency if the application already has the register value.
+    *
+    * This method is not supported by the NOISE_CHANNEL.
+    *
+    * \sa setFrequency()
+    *
+    * \param chan  channel number on which to play this note [0..MAX_CHANNELS-2].
+    * \param div   tone divider for the specified channel [1..1023], 0 is the same as 1024.
+    */
+    void setDivider(uint8_t chan, uint16_t div);
+
     /**
      * Set the noise channel parameters.
      *
@@ -440,6 +912,8 @@ class MD_SN76489
      * Noise may be one of the noiseType_t types.
      *
      * New settings will immediately replace old settings for for NOISE_CHANNEL.
+     * The setting is always written to the IC, even if it is unchanged, as
+     * this restarts the noise.
      *
      * \param  noise one of the valid noise types in noiseType_t.
      */
@@ -503,6 +977,30 @@ class MD_SN76489
     */
     void note(uint8_t chan, uint16_t freq, uint8_t volume, uint16_t duration = 0);
 
+   /**
+    * Play a MIDI note on using ADSR.
+    *
+    * Same as note() with the note specified as a MIDI note number (60 is 
+    * middle C, 69 is A4 at 440Hz). The tone divider for each MIDI note is 
+    * held in a table worked out by the compiler for SN_CLOCK_HZ, so no 
+    * arithmetic is needed to start the note. If a different clock is set with
+    * begin(uint32_t) the divider is scaled by a fixed point ratio of the 
+    * clocks. Notes below the lowest frequency of the IC are played at the 
+    * lowest frequency.
+    *
+    * If midiNote is greater than 127 the note is turned off.
+    *
+    * This method is not supported by the NOISE_CHANNEL.
+    *
+    * \sa note()
+    *
+    * \param chan     channel number on which to play this note [0..MAX_CHANNELS-2].
+    * \param midiNote MIDI note number to play [0..127].
+    * \param volume   volume to play, default to VOL_MAX, in the range [0..VOL_MAX]
+    * \param duration length of time in ms for the whole note to last.
+    */
+    void noteMidi(uint8_t chan, uint8_t midiNote, uint8_t volume, uint16_t duration = 0);
+
     /**
      * Play a noise using ADSR.
      *
@@ -574,8 +1072,99 @@ class MD_SN76489
     * Runs the ADSR finite state machine for all channels. This should be called
     * from the main loop() as frequently as possible to allow the library to execute
     * the note required timing for the note envelopes.
+    *
+    * The current time is taken from millis(), or micros() if SN_TIME_US is enabled.
+    *
+    * \sa play(uint32_t)
+    */
+    inline void play(void) { play(SN_TIME_NOW()); }
+
+   /**
+    * Play the music machine at a specified time.
+    *
+    * Runs the ADSR finite state machine for all channels using the time supplied 
+    * by the application instead of millis() or micros(). All envelope timing, including the 
+    * start time of notes queued by note(), tone() and noise(), is taken from the
+    * time passed to this method. The time must not go backwards between calls.
+    *
+    * This allows the music to be played against a virtual clock, for example
+    * to render audio faster than real time using MD_SN76489_Emu, or to produce 
+    * exactly repeatable results.
+    *
+    * \sa play()
+    *
+    * \param now  the current time in milliseconds, or microseconds if SN_TIME_US is enabled.
+    */
+    void play(uint32_t now);
+
+   /**
+    * Get the time to the next envelope event.
+    *
+    * Works out how long until play() next has something to do on any channel
+    * (an envelope volume step, the end of a sustain duration or a pending note 
+    * on or off). The application can use this to sleep or do other work until
+    * play() next needs to be called.
+    *
+    * A channel that is sustaining a note with no duration waits for the 
+    * application to turn it off, so it has no scheduled event.
+    *
+    * The current time is taken from millis(), or micros() if SN_TIME_US is enabled.
+    * The time returned is always in milliseconds, rounded up so that an event
+    * less than 1ms away is not reported as due now. Any delay this adds is 
+    * made up by play(), which runs all the envelope steps that are due.
+    *
+    * \sa nextEventMs(uint32_t)
+    *
+    * \return the time in ms until play() should next be called, 0 if it is 
+    * due now or NO_EVENT if there is nothing scheduled.
+    */
+    inline uint32_t nextEventMs(void) { return(nextEventMs(SN_TIME_NOW())); }
+
+   /**
+    * Get the time to the next envelope event at a specified time.
+    *
+    * Same as nextEventMs() with the current time supplied by the application,
+    * as for play(uint32_t).
+    *
+    * \sa nextEventMs()
+    *
+    * \param now  the current time in milliseconds, or microseconds if SN_TIME_US is enabled.
+    * \return the time in ms until play() should next be called, 0 if it is 
+    * due now or NO_EVENT if there is nothing scheduled.
+    */
+    uint32_t nextEventMs(uint32_t now);
+
+#if SN_TIMER_PLAY
+   /**
+    * Run the envelopes from a timer interrupt.
+    *
+    * When enabled, the library sets up a 1kHz timer interrupt that runs the 
+    * ADSR state machine for this object, and play() no longer needs to be 
+    * called by the application. Only one object can use the timer.
+    *
+    * See \ref pageLibrary for the timer used by each MCU.
+    *
+    * \param enable  true to start the timer interrupt, false to stop it.
+    * \return true if the change was made, false if the timer is used by 
+    * another object or there is no timer support for this MCU.
     */
-    void play(void);
+    bool setTimerPlay(bool enable);
+
+   /**
+    * Get the timer interrupt mode.
+    *
+    * \return true if the envelopes for this object are run by the timer interrupt.
+    */
+    inline bool getTimerPlay(void) { return(_timerObj == this); }
+
+   /**
+    * Timer interrupt handler.
+    *
+    * Called by the library timer interrupt service routine. Not for use by 
+    * the application.
+    */
+    static void timerISR(void);
+#endif
 
    /**
     * Write a byte directly to the device
@@ -587,12 +1176,171 @@ class MD_SN76489
     *
     * \param data  the 8 bit data value to write to the device.
     */
-    inline void write(uint8_t data) { send(data); }
+    inline void write(uint8_t data) { SN_LOCK(); _regs.decode(data); send(data); SN_UNLOCK(); }
+
+   /**
+    * Write a buffer of bytes directly to the device
+    *
+    * Writes len bytes to the device in the order given. As for the single
+    * byte write(), this method bypasses all the checks and buffering built 
+    * into the library. Hardware set up is done once for all the bytes, 
+    * making this more efficient for sending a group of register settings
+    * (eg, a frame of VGM data or a chord change).
+    *
+    * \param data  pointer to the buffer of data bytes to write to the device.
+    * \param len   the number of bytes in the buffer.
+    */
+    void write(const uint8_t* data, size_t len);
+
+   /** @} */
+
+    //--------------------------------------------------------------
+    /** \name Register shadow cache.
+     * @{
+     */
+
+   /**
+    * Get the number of suppressed writes.
+    *
+    * Returns the number of bytes that were not sent to the IC because the
+    * register already held the value being set.
+    *
+    * \sa resetSuppressedWrites()
+    *
+    * \return the number of suppressed bytes since begin() or the last reset.
+    */
+    inline uint32_t getSuppressedWrites(void) { return(_suppressed); }
+
+   /**
+    * Reset the suppressed writes counter.
+    *
+    * \sa getSuppressedWrites()
+    */
+    inline void resetSuppressedWrites(void) { _suppressed = 0; }
+
+   /**
+    * Invalidate the register shadow cache.
+    *
+    * Marks all the shadow registers as unknown, so that the next setting
+    * of each register is always written to the IC. Use this if the IC is 
+    * reset or written outside the control of the library.
+    */
+    inline void invalidateRegs(void) { _regs.reset(); }
+
+   /**
+    * Get the register shadow cache.
+    *
+    * \return a reference to the register model tracking the IC registers.
+    */
+    inline const MD_SN76489_Regs& getRegs(void) { return(_regs); }
 
    /** @} */
+
+#if SN_QUEUE_SIZE
+    //--------------------------------------------------------------
+    /** \name Timed write queue.
+     * @{
+     */
+
+   /**
+    * Queue a byte to be written at a set time.
+    *
+    * The byte is added to the timed write queue and sent to the device
+    * by poll() once the specified time has been reached. Bytes must be 
+    * queued in time order.
+    *
+    * \sa poll()
+    *
+    * \param data  the 8 bit data value to write to the device.
+    * \param t     the micros() time at which the byte is sent.
+    * \return true if the byte was queued, false if the queue is full.
+    */
+    bool queue(uint8_t data, uint32_t t);
+
+   /**
+    * Queue a buffer of bytes to be written at a set time.
+    *
+    * All the bytes are added to the timed write queue to be sent together 
+    * once the specified time has been reached. If the queue does not have 
+    * space for all the bytes, none are queued.
+    *
+    * \sa poll()
+    *
+    * \param data  pointer to the buffer of data bytes to write to the device.
+    * \param len   the number of bytes in the buffer.
+    * \param t     the micros() time at which the bytes are sent.
+    * \return true if the bytes were queued, false if the queue is full.
+    */
+    bool queue(const uint8_t* data, size_t len, uint32_t t);
+
+   /**
+    * Send queued bytes that are due.
+    *
+    * Sends all the bytes at the head of the queue that have reached their
+    * due time. This should be called from the main loop() as frequently as 
+    * possible, or from a periodic timer interrupt.
+    *
+    * \sa queue()
+    */
+    inline void poll(void) { poll(micros()); }
+
+   /**
+    * Send queued bytes that are due at the given time.
+    *
+    * Same as poll(), but the current time is supplied by the caller.
+    *
+    * \param now   the current time in microseconds.
+    */
+    void poll(uint32_t now);
+
+   /**
+    * Empty the timed write queue.
+    *
+    * All the bytes in the queue are discarded without being sent. The bytes
+    * are removed by the next call to poll(), so that only poll() changes the
+    * tail of the queue, and are counted by getQueueCount() until then. Bytes 
+    * queued after this call are not discarded.
+    */
+    void clearQueue(void);
+
+   /**
+    * Get the number of bytes in the queue.
+    *
+    * \return the number of bytes waiting to be sent.
+    */
+    uint8_t getQueueCount(void);
+
+   /**
+    * Get the queue high water mark.
+    *
+    * \return the maximum number of bytes held in the queue since begin().
+    */
+    inline uint8_t getQueueHighWater(void) { return(_qHighWater); }
+
+   /**
+    * Get the queue overflow count.
+    *
+    * \return the number of bytes rejected because the queue was full since begin().
+    */
+    inline uint16_t getQueueOverflow(void) { return(_qOverflow); }
+
+   /** @} */
+#endif
   protected:
     const uint8_t DATA_BITS = 8;        ///< Number of bits in the byte (for loops)
 
+   /**
+    * Send a sequence of bytes to the SN76489IC.
+    *
+    * Sends len bytes from the data buffer to the device in the order given.
+    * The base class method calls send() for each byte. Derived classes may 
+    * replace this method to set up the hardware once for all the bytes.
+    *
+    * \param data  pointer to the data bytes to transmit
+    * \param len   the number of bytes in the data buffer
+    */
+    virtual void sendBurst(const uint8_t* data, size_t len);
+
    /**
     * Send a byte to the SN76489IC.
     *
@@ -604,10 +1352,27 @@ class MD_SN76489
     */
     virtual void send(uint8_t data);
 
-  private:
+#if SN_TIMER_PLAY
+   /**
+    * Prepare the transport for writes from the timer interrupt.
+    *
+    * Called by setTimerPlay() when the timer interrupt is started for this 
+    * object, so that a transport sharing a bus with other devices can stop 
+    * the interrupt writing to the IC in the middle of another transfer. The
+    * base class method does nothing.
+    */
+    virtual void timerPlayStart(void) {};
+#endif
+
     // Hardware register definitions
-    const uint32_t CLOCK_HZ = 4000000UL;  ///< 4Mhz clock
+    const uint8_t WRITE_CYCLES = 32;      ///< IC clock cycles to latch written data
+    const uint16_t DIVIDER_MAX = 1023;    ///< largest tone divider (lowest frequency)
+
+    uint32_t _clockHz;    ///< IC clock frequency in Hz
+    uint8_t _writeUs;     ///< microseconds for WRITE_CYCLES clock cycles, set in begin()
+    MD_SN76489_Regs _regs;///< shadow copy of the IC registers
 
+  private:
     // 1CCTDDDD - 1=Latch+Data, CC=Channel, T=Type, DDDD=Data1
     const uint8_t LATCH_CMD = 0x80;  ///< Latch register indicator
     const uint8_t DATA1_MASK = 0x0f; ///< 4-bits LSB of data [DATA2|DATA1]
@@ -639,16 +1404,18 @@ class MD_SN76489
     {
       uint8_t volSP;  ///< volume setpoint for this channel, 0-15 (map to attenuator 15-0)
       uint8_t volCV;  ///< volume current value for this channel, 0-15 (map to attenuator 15-0)
+      uint8_t volEnd; ///< volume value at the end of the current ADSR phase
       int8_t volumeStep;  ///< the volume step increment (+1/-1) during ADSR
 
-      uint16_t frequency; ///< the frequency being played (or noise settings for NOISE_CHANNEL)
+      uint16_t divider;   ///< the tone divider being played (or noise settings for NOISE_CHANNEL)
       uint16_t duration;  ///< the total playing duration for the sustain phase
       bool playTone;      ///< true if we are just playing a tone.
 
       channelState_t  state;  ///< current note playing state
 
-      uint32_t timeBase;  ///< base time for current time operation
-      uint32_t timeStep;  ///< time for each volume step up or down
+      uint32_t timeBase;  ///< base time for current time operation, in library time units (ms or us)
+      uint32_t timeStep;  ///< time for each volume step up or down, 16.16 fixed point ms
+      uint16_t timeAcc;   ///< fraction of a library time unit to add to timeBase, 0.16 fixed point
 
       const adsrEnvelope_t *adsr;  ///< current channel adsr envelope
     };
@@ -657,40 +1424,86 @@ class MD_SN76489
 
     // Variables
     bool _clock;          ///< use MCU as the clock signal generator
+    uint32_t _clockK;     ///< IC clock / 32, the tone divider numerator
+    uint16_t _clockKn;    ///< _clockK shifted right by _clockKsh to fit in 15 bits
+    uint8_t _clockKsh;    ///< shift to normalize _clockK
+    uint16_t _freqMin;    ///< lowest frequency that fits in the tone divider
+    uint32_t _midiScale;  ///< MIDI note table scale for this clock, 16.16 fixed point
+    uint32_t _suppressed; ///< count of bytes not sent as register unchanged
+
+#if SN_QUEUE_SIZE
+    static_assert((SN_QUEUE_SIZE & (SN_QUEUE_SIZE - 1)) == 0 && SN_QUEUE_SIZE <= 128, "SN_QUEUE_SIZE must be a power of 2 <= 128");
+
+    // Timed write queue
+    struct queueEntry_t
+    {
+      uint32_t time;  ///< micros() time to send the data
+      uint8_t data;   ///< data byte to send
+    };
+
+    queueEntry_t _q[SN_QUEUE_SIZE]; ///< timed write queue entries
+    volatile uint8_t _qHead;  ///< next entry to fill, only changed by queue()
+    volatile uint8_t _qTail;  ///< next entry to send, only changed by poll()
+    volatile uint8_t _qClearTo; ///< head when clearQueue() was called
+    volatile bool _qClear;    ///< set by clearQueue() for poll() to discard the entries up to _qClearTo
+    uint8_t _qHighWater;      ///< maximum number of entries used
+    uint16_t _qOverflow;      ///< count of bytes rejected because queue full
+#endif
     
     // Methods
     void startClock(void);              ///< use the MCU timers to generate 4MHz clock
     void setCVolume(uint8_t chan, uint8_t v);         ///< set current volume level
     uint8_t saneVolume(uint8_t volume); ///< return a volume setting within bounds
     uint16_t calcTs(uint8_t chan, uint16_t duration); ///< work out the Vs time for this note
+    uint16_t freqToDivider(uint16_t freq); ///< work out the tone divider for a frequency
+    void noteDivider(uint8_t chan, uint16_t div, uint8_t volume, uint16_t duration); ///< queue a note using the tone divider
+    void runFSM(uint32_t now);          ///< run the ADSR state machine for all channels
+    void startPhase(uint8_t chan, uint32_t now, uint16_t t, uint8_t volEnd); ///< set up the steps for an ADSR phase
+    inline uint32_t stepTime(uint8_t chan) { return(((C[chan].timeStep >> 16) * SN_TIME_SCALE) + ((C[chan].timeAcc + ((C[chan].timeStep & 0xffff) * SN_TIME_SCALE)) >> 16)); } ///< time from timeBase to the next ADSR step
+
+#if SN_TIMER_PLAY
+    static MD_SN76489* volatile _timerObj;  ///< object with envelopes run by the timer, or nullptr
+#endif
 
     // Data
     adsrEnvelope_t _adsrDefault;  ///< default ADSR envelope, initialize in constructor
 };
 
 /**
- * Derived class for direct I/O control of the SN76489 IC
+ * Template class for a SN76489 IC with a transport known at compile time.
+ *
+ * The BUS class does the hardware data transfer and must provide the methods
+ * - void begin(void) to set up the hardware
+ * - void send(const uint8_t* data, size_t len, uint8_t writeUs) to send len 
+ *   bytes to the IC, waiting writeUs microseconds for each byte to latch.
+ * - void usingInterrupt(void) to protect a bus shared with other devices from
+ *   the writes made by the timer interrupt (see setTimerPlay()).
+ *
+ * The write() methods call the BUS directly rather than through the virtual 
+ * send() methods, so the compiler can inline the whole write path. With 
+ * one of the pin template buses (MD_SN76489_DirectPins, MD_SN76489_SPIPins)
+ * the pin numbers are constants and the pin writes are also worked out by 
+ * the compiler.
+ *
+ * MD_SN76489_Direct and MD_SN76489_SPI are this template with the pins set 
+ * at run time.
+ *
+ * \sa \ref pageLibrary
  */
-class MD_SN76489_Direct: public MD_SN76489
+template <class BUS>
+class MD_SN76489_T: public MD_SN76489
 {
 public:
   /**
    * Class Constructor.
    *
-   * Instantiate a new instance of this derived class. The parameters passed are used to
-   * connect the software to the hardware. Multiple instances may co-exist.
+   * Instantiate a new instance of this class. Multiple instances may co-exist.
    *
-   * The D array is arranged to correspond to the IC pins (ie, pin D[0] is connected
-   * to IC pin D0, D[1] to D1, etc). D0 is the MSB in the data byte, D7 the LSB.
-   *
-   * \sa \ref pageHardware
-   *
-   * \param D       pointer to array of 8 pins number used to interface to SN76489 IC pins D0 to D7 in that order.
-   * \param we      pin number used as write enable for the SN76489 IC
    * \param MCUclk  if true the 4MHz clock signal is generated using MCU timers (hardware dependency)
-  */
-  MD_SN76489_Direct(const uint8_t* D, uint8_t we, bool MCUclk):
-    MD_SN76489(MCUclk), _D(D), _we(we)
+   * \param bus     the transport used to send data to the IC, default constructed if not specified.
+   */
+  MD_SN76489_T(bool MCUclk, const BUS& bus = BUS()) :
+    MD_SN76489(MCUclk), _bus(bus)
   {};
 
   /**
@@ -698,32 +1511,330 @@ public:
    *
    * Initialize the object data. This needs to be called during setup() to initialize
    * new data for the class that cannot be done during the object creation.
-   * 
-   * Initializes the output pins.
+   *
+   * Initializes the transport hardware and then the base class.
    */
-  void begin(void);
+  void begin(void) { _bus.begin(); MD_SN76489::begin(); }
+  using MD_SN76489::begin;   // begin(clockHz) from the base class
+
+  /**
+   * Write a byte directly to the device.
+   *
+   * As MD_SN76489::write(uint8_t), with the data sent straight to the BUS.
+   *
+   * \param data  the byte to write to the device.
+   */
+  inline void write(uint8_t data) { SN_LOCK(); _regs.decode(data); _bus.send(&data, 1, _writeUs); SN_UNLOCK(); }
+
+  /**
+   * Write a buffer of bytes directly to the device.
+   *
+   * As MD_SN76489::write(const uint8_t*, size_t), with the data sent straight
+   * to the BUS.
+   *
+   * \param data  pointer to the buffer of data bytes to write to the device.
+   * \param len   the number of bytes in the buffer.
+   */
+  inline void write(const uint8_t* data, size_t len)
+  {
+    SN_LOCK();
+    for (size_t i = 0; i < len; i++)
+      _regs.decode(data[i]);
+    _bus.send(data, len, _writeUs);
+    SN_UNLOCK();
+  }
 
 protected:
  /**
   * Send a byte to the SN76489IC.
   *
-  * Send a byte to the SN76489 IC directly connected to the MCU I/O pins.
+  * \param data  the data byte to transmit
+  */
+  void send(uint8_t data) { _bus.send(&data, 1, _writeUs); }
+
+#if SN_TIMER_PLAY
+ /**
+  * Prepare the BUS for writes from the timer interrupt.
+  */
+  void timerPlayStart(void) { _bus.usingInterrupt(); }
+#endif
+
+ /**
+  * Send a sequence of bytes to the SN76489IC.
+  *
+  * \param data  pointer to the data bytes to transmit
+  * \param len   the number of bytes in the data buffer
+  */
+  void sendBurst(const uint8_t* data, size_t len) { _bus.send(data, len, _writeUs); }
+
+  BUS _bus;   ///< the transport for data sent to the IC
+};
+
+/**
+ * Digital I/O for a pin number known at compile time.
+ *
+ * Used by the pin template buses. For the ATmega328P and ATmega168 (Uno, Nano, 
+ * Mini) the port register and bit mask for the pin are worked out by the 
+ * compiler, so a pin write is a single bit set or clear instruction. For 
+ * other MCUs the Arduino digital I/O functions are used.
+ */
+template <uint8_t PIN>
+struct MD_SN76489_Pin
+{
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+  static_assert(PIN < 20 || PIN == MD_SN76489::NO_PIN, "Pin number not valid for this MCU");
+
+  static const uint8_t MASK = 1 << ((PIN < 8) ? PIN : ((PIN < 14) ? PIN - 8 : ((PIN < 20) ? PIN - 14 : 0)));  ///< port bit mask for the pin
+
+  static inline volatile uint8_t& out(void) { return((PIN < 8) ? PORTD : ((PIN < 14) ? PORTB : PORTC)); } ///< port output register
+  static inline volatile uint8_t& in(void) { return((PIN < 8) ? PIND : ((PIN < 14) ? PINB : PINC)); }    ///< port input register
+
+  static inline void write(uint8_t v) { if (v) out() |= MASK; else out() &= ~MASK; } ///< set the pin HIGH or LOW
+  static inline uint8_t read(void) { return((in() & MASK) ? HIGH : LOW); }         ///< read the pin
+#else
+  static inline void write(uint8_t v) { digitalWrite(PIN, v); }   ///< set the pin HIGH or LOW
+  static inline uint8_t read(void) { return(digitalRead(PIN)); }  ///< read the pin
+#endif
+
+ /**
+  * Wait for the SN76489 IC to latch the data.
+  *
+  * As MD_SN76489::writeWait() with PIN as the READY pin.
+  *
+  * \param writeUs microseconds for the IC to latch the data
+  */
+  static inline void waitReady(uint8_t writeUs)
+  {
+    if (PIN == MD_SN76489::NO_PIN)
+      delayMicroseconds(writeUs);
+    else
+    {
+      uint32_t timeStart = micros();
+
+      while (read() == LOW && (micros() - timeStart < 2 * writeUs))
+        ;  // wait
+    }
+  }
+};
+
+/**
+ * Transport for MD_SN76489_T using direct I/O pins known at compile time.
+ *
+ * The template parameters are the pins connected to the IC D0 to D7, WE and 
+ * optionally READY. If D0 to D7 are pins 7 to 0 of an ATmega328P (port D 
+ * bits 7 to 0) the data byte is written to the port in one store.
+ *
+ * \sa \ref pageHardware
+ */
+template <uint8_t D0, uint8_t D1, uint8_t D2, uint8_t D3, uint8_t D4, uint8_t D5, uint8_t D6, uint8_t D7,
+          uint8_t WE, uint8_t RDY = MD_SN76489::NO_PIN>
+class MD_SN76489_DirectPins
+{
+public:
+ /**
+  * Set up the data, WE and READY pins.
+  */
+  void begin(void)
+  {
+    const uint8_t D[] = { D0, D1, D2, D3, D4, D5, D6, D7 };
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(D); i++)
+      pinMode(D[i], OUTPUT);
+    pinMode(WE, OUTPUT);
+    if (RDY != MD_SN76489::NO_PIN)
+      pinMode(RDY, INPUT_PULLUP);
+  }
+
+ /**
+  * Send a sequence of bytes to the SN76489 IC.
+  *
+  * \param data    pointer to the data bytes to transmit
+  * \param len     the number of bytes in the data buffer
+  * \param writeUs microseconds for the IC to latch each byte
+  */
+  inline void send(const uint8_t* data, size_t len, uint8_t writeUs)
+  {
+    MD_SN76489_Pin<WE>::write(HIGH);
+
+    for (size_t n = 0; n < len; n++)
+    {
+      uint8_t d = data[n];
+
+      // Set the data pins to current value, D0 is the MSB
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+      if (D0 == 7 && D1 == 6 && D2 == 5 && D3 == 4 && D4 == 3 && D5 == 2 && D6 == 1 && D7 == 0)
+        PORTD = d;
+      else
+#endif
+      {
+        MD_SN76489_Pin<D0>::write(d & 0x80);
+        MD_SN76489_Pin<D1>::write(d & 0x40);
+        MD_SN76489_Pin<D2>::write(d & 0x20);
+        MD_SN76489_Pin<D3>::write(d & 0x10);
+        MD_SN76489_Pin<D4>::write(d & 0x08);
+        MD_SN76489_Pin<D5>::write(d & 0x04);
+        MD_SN76489_Pin<D6>::write(d & 0x02);
+        MD_SN76489_Pin<D7>::write(d & 0x01);
+      }
+
+      // Toggle !WE LOW then HIGH to latch it in the IC
+      MD_SN76489_Pin<WE>::write(LOW);
+      MD_SN76489_Pin<RDY>::waitReady(writeUs);
+      MD_SN76489_Pin<WE>::write(HIGH);
+    }
+  }
+
+ /**
+  * Prepare for writes from the timer interrupt. The pins are not shared, so
+  * there is nothing to do.
+  */
+  inline void usingInterrupt(void) {}
+};
+
+/**
+ * Transport for MD_SN76489_T using hardware SPI with pins known at compile time.
+ *
+ * The template parameters are the pins connected to the 74595 buffer LD 
+ * input, the IC WE and optionally READY, and the SPI clock frequency. The 
+ * 74595 data and clock inputs are connected to the MCU MOSI and SCK pins.
+ *
+ * \sa \ref pageHardware
+ */
+template <uint8_t LD, uint8_t WE, uint32_t SPI_HZ = 8000000UL, uint8_t RDY = MD_SN76489::NO_PIN>
+class MD_SN76489_SPIPins
+{
+public:
+ /**
+  * Set up the SPI peripheral and the LD, WE and READY pins.
+  */
+  void begin(void)
+  {
+    SPI.begin();
+    pinMode(LD, OUTPUT);
+    pinMode(WE, OUTPUT);
+    if (RDY != MD_SN76489::NO_PIN)
+      pinMode(RDY, INPUT_PULLUP);
+  }
+
+ /**
+  * Send a sequence of bytes to the SN76489 IC in one SPI transaction.
+  *
+  * \param data    pointer to the data bytes to transmit
+  * \param len     the number of bytes in the data buffer
+  * \param writeUs microseconds for the IC to latch each byte
+  */
+  inline void send(const uint8_t* data, size_t len, uint8_t writeUs)
+  {
+    SPI.beginTransaction(SPISettings(SPI_HZ, MSBFIRST, SPI_MODE0));
+    MD_SN76489_Pin<WE>::write(HIGH);
+
+    for (size_t n = 0; n < len; n++)
+    {
+      // Load the data in the 595 buffer
+      MD_SN76489_Pin<LD>::write(LOW);
+      SPI.transfer(data[n]);
+      MD_SN76489_Pin<LD>::write(HIGH);
+
+      // Toggle !WE LOW then HIGH to latch it in the IC
+      MD_SN76489_Pin<WE>::write(LOW);
+      MD_SN76489_Pin<RDY>::waitReady(writeUs);
+      MD_SN76489_Pin<WE>::write(HIGH);
+    }
+
+    SPI.endTransaction();
+  }
+
+ /**
+  * Prepare for writes from the timer interrupt.
+  *
+  * Registers the interrupt with the SPI library, so that SPI transactions 
+  * for other devices (eg, an SD card) hold it off until they are complete.
+  */
+  inline void usingInterrupt(void)
+  {
+#if defined(__AVR__)
+    SPI.usingInterrupt(255);  // the AVR SPI library masks all interrupts for a timer
+#endif
+  }
+};
+
+/**
+ * Transport for MD_SN76489_T using direct I/O pins set at run time.
+ *
+ * Used by MD_SN76489_Direct.
+ */
+class MD_SN76489_DirectBus
+{
+public:
+ /**
+  * Class Constructor.
+  *
+  * \param D    pointer to array of 8 pins number used to interface to SN76489 IC pins D0 to D7 in that order.
+  * \param we   pin number used as write enable for the SN76489 IC
+  * \param rdy  pin number connected to the SN76489 IC READY output or NO_PIN
+  */
+  MD_SN76489_DirectBus(const uint8_t* D, uint8_t we, uint8_t rdy) :
+    _D(D), _we(we), _rdy(rdy)
+  {};
+
+ /**
+  * Set up the data, WE and READY pins.
+  *
+  * If SN_FAST_IO is enabled, also works out the port registers and bit masks 
+  * used by the data and WE pins.
+  */
+  void begin(void);
+
+ /**
+  * Send a sequence of bytes to the SN76489 IC.
+  *
   * Uses the pin number from the D array to send data D0-D7, where D0 is 
-  * the MSB.
+  * the MSB. The WE pin is set up once for all the bytes.
   *
-  * \param data  the data byte to transmit
+  * \param data    pointer to the data bytes to transmit
+  * \param len     the number of bytes in the data buffer
+  * \param writeUs microseconds for the IC to latch each byte
   */
-  void send(uint8_t data);
+  void send(const uint8_t* data, size_t len, uint8_t writeUs);
+
+ /**
+  * Prepare for writes from the timer interrupt. The pins are not shared, so
+  * there is nothing to do.
+  */
+  inline void usingInterrupt(void) {}
 
 private:
+  const uint8_t DATA_BITS = 8;  ///< Number of bits in the byte (for loops)
+
   const uint8_t* _D;    ///< SN76489 IC pins D0-D7 in that order
   uint8_t _we;          ///< SN76489 write Enable output pin (active low)
+  uint8_t _rdy;         ///< SN76489 READY input pin or NO_PIN
+
+#if SN_FAST_IO
+  // Port mapping for the I/O pins, worked out in begin()
+  struct portMap_t
+  {
+    volatile uint8_t *reg;  ///< port output register
+    uint8_t mask;           ///< bit mask of all the data pins on this port
+  };
+
+  portMap_t _port[8];       ///< ports used by D0-D7, one entry per port (max 8)
+  uint8_t _portCount;       ///< number of valid entries in _port[]
+  uint8_t _pinPort[8];      ///< index into _port[] for each of D0-D7
+  uint8_t _pinMask[8];      ///< port bit mask for each of D0-D7
+  bool _portDirect;         ///< true if D0-D7 are port bits 7-0 of a single port
+
+  volatile uint8_t *_weReg; ///< port output register for the WE pin
+  uint8_t _weMask;          ///< port bit mask for the WE pin
+  volatile uint8_t *_rdyReg;///< port input register for the READY pin
+  uint8_t _rdyMask;         ///< port bit mask for the READY pin
+#endif
 };
 
 /**
- * Derived class for SPI 74595 buffer control of the SN76489 IC
+ * Derived class for direct I/O control of the SN76489 IC
  */
-class MD_SN76489_SPI: public MD_SN76489
+class MD_SN76489_Direct: public MD_SN76489_T<MD_SN76489_DirectBus>
 {
 public:
   /**
@@ -737,14 +1848,162 @@ public:
    *
    * \sa \ref pageHardware
    *
+   * \param D       pointer to array of 8 pins number used to interface to SN76489 IC pins D0 to D7 in that order.
+   * \param we      pin number used as write enable for the SN76489 IC
+   * \param MCUclk  if true the 4MHz clock signal is generated using MCU timers (hardware dependency)
+   * \param rdy     pin number connected to the SN76489 IC READY output, default NO_PIN (not used)
+  */
+  MD_SN76489_Direct(const uint8_t* D, uint8_t we, bool MCUclk, uint8_t rdy = NO_PIN):
+    MD_SN76489_T(MCUclk, MD_SN76489_DirectBus(D, we, rdy))
+  {};
+};
+
+/**
+ * Transport for MD_SN76489_T using a 74595 buffer loaded by SPI, with the
+ * pins set at run time.
+ *
+ * Used by MD_SN76489_SPI.
+ */
+class MD_SN76489_SPIBus
+{
+public:
+ /**
+  * Class Constructor for software SPI.
+  *
+  * \param ld   the SPI pin to toggle to load the data in the 595 buffer
+  * \param dat  the SPI pin to toggle for data transmission to the 595 buffer
+  * \param clk  the SPI pin to toggle for clocking data into the 595 buffer
+  * \param we   pin number used as write enable for the SN76489 IC
+  * \param rdy  pin number connected to the SN76489 IC READY output or NO_PIN
+  */
+  MD_SN76489_SPIBus(uint8_t ld, uint8_t dat, uint8_t clk, uint8_t we, uint8_t rdy) :
+    _dat(dat), _ld(ld), _clk(clk), _we(we), _rdy(rdy), _hwSPI(false)
+  {};
+
+ /**
+  * Class Constructor for hardware SPI.
+  *
+  * \param ld       the pin to toggle to load the data in the 595 buffer
+  * \param we       pin number used as write enable for the SN76489 IC
+  * \param spiClock the SPI clock frequency in Hz.
+  * \param rdy      pin number connected to the SN76489 IC READY output or NO_PIN
+  */
+  MD_SN76489_SPIBus(uint8_t ld, uint8_t we, uint32_t spiClock, uint8_t rdy) :
+    _dat(MOSI), _ld(ld), _clk(SCK), _we(we), _rdy(rdy), _hwSPI(true),
+    _spiSettings(spiClock, MSBFIRST, SPI_MODE0)
+  {};
+
+ /**
+  * Set up the SPI peripheral or pins and the LD, WE and READY pins.
+  */
+  void begin(void);
+
+ /**
+  * Send a sequence of bytes to the SN76489 IC.
+  *
+  * Send len bytes to the SN76489 IC through the 74595 buffer. When hardware
+  * SPI is used all the bytes are sent within the same SPI transaction.
+  *
+  * \param data    pointer to the data bytes to transmit
+  * \param len     the number of bytes in the data buffer
+  * \param writeUs microseconds for the IC to latch each byte
+  */
+  void send(const uint8_t* data, size_t len, uint8_t writeUs);
+
+ /**
+  * Prepare for writes from the timer interrupt.
+  *
+  * With hardware SPI, registers the interrupt with the SPI library so that
+  * SPI transactions for other devices (eg, an SD card) hold it off until 
+  * they are complete.
+  */
+  void usingInterrupt(void);
+
+private:
+  uint8_t _dat;  ///< SPI data out pin (MOSI)
+  uint8_t _ld;   ///< SPI load data pin (LD)
+  uint8_t _clk;  ///< SPI clock pin (CLK)
+  uint8_t _we;   ///< SN76489 Write Enable output pin (active low)
+  uint8_t _rdy;  ///< SN76489 READY input pin or NO_PIN
+  bool _hwSPI;   ///< true if using the hardware SPI peripheral
+  SPISettings _spiSettings; ///< hardware SPI transaction settings
+};
+
+/**
+ * Derived class for SPI 74595 buffer control of the SN76489 IC
+ */
+class MD_SN76489_SPI: public MD_SN76489_T<MD_SN76489_SPIBus>
+{
+public:
+  /**
+   * Class Constructor.
+   *
+   * Instantiate a new instance of this derived class. The parameters passed are used to
+   * connect the software to the hardware. Multiple instances may co-exist.
+   *
+   * \sa \ref pageHardware
+   *
    * \param ld     the SPI pin to toggle to load the data in the 595 buffer
    * \param dat    the SPI pin to toggle for data transmission to the 595 buffer
    * \param clk    the SPI pin to toggle for clocking data into the 595 buffer
    * \param we     pin number used as write enable for the SN76489 IC
    * \param MCUclk if true the 4MHz clock signal is generated using MCU timers (hardware dependency)
+   * \param rdy    pin number connected to the SN76489 IC READY output, default NO_PIN (not used)
   */
-  MD_SN76489_SPI(uint8_t  ld, uint8_t dat, uint8_t clk, uint8_t we, bool MCUclk) :
-    MD_SN76489(MCUclk), _dat(dat), _ld(ld), _clk(clk), _we(we)
+  MD_SN76489_SPI(uint8_t  ld, uint8_t dat, uint8_t clk, uint8_t we, bool MCUclk, uint8_t rdy = NO_PIN) :
+    MD_SN76489_T(MCUclk, MD_SN76489_SPIBus(ld, dat, clk, we, rdy))
+  {};
+
+  /**
+   * Class Constructor for hardware SPI.
+   *
+   * Instantiate a new instance of this derived class using the MCU hardware 
+   * SPI peripheral to load the 595 buffer. The 595 data and clock inputs must 
+   * be connected to the MCU MOSI and SCK pins. Multiple instances may co-exist.
+   *
+   * \sa \ref pageHardware
+   *
+   * \param ld       the pin to toggle to load the data in the 595 buffer
+   * \param we       pin number used as write enable for the SN76489 IC
+   * \param MCUclk   if true the 4MHz clock signal is generated using MCU timers (hardware dependency)
+   * \param spiClock the SPI clock frequency in Hz, default 8MHz.
+   * \param rdy      pin number connected to the SN76489 IC READY output, default NO_PIN (not used)
+   */
+  MD_SN76489_SPI(uint8_t ld, uint8_t we, bool MCUclk, uint32_t spiClock = 8000000UL, uint8_t rdy = NO_PIN) :
+    MD_SN76489_T(MCUclk, MD_SN76489_SPIBus(ld, we, spiClock, rdy))
+  {};
+};
+
+/**
+ * Derived class for software emulation of the SN76489 IC
+ */
+class MD_SN76489_Emu: public MD_SN76489
+{
+public:
+  /**
+   * Noise shift register type enumerated definitions
+   * The noise generator shift register width and feedback taps are different 
+   * for the variants of the IC.
+   */
+  typedef enum
+  {
+    LFSR_TI,    ///< TI SN76489, 15 bit shift register tapped on bits 0 and 1
+    LFSR_SEGA,  ///< SEGA variant, 16 bit shift register tapped on bits 0 and 3
+  } lfsrType_t;
+
+  /**
+   * Class Constructor.
+   *
+   * Instantiate a new instance of this derived class. Multiple instances may co-exist.
+   *
+   * \param sampleRate the rate in Hz of the PCM samples produced, default 44100.
+   * \param lfsr       the type of noise shift register to emulate, default LFSR_TI.
+   */
+  MD_SN76489_Emu(uint32_t sampleRate = 44100, lfsrType_t lfsr = LFSR_TI) :
+    MD_SN76489(false), _sampleRate(sampleRate), _lfsrType(lfsr)
+#if SN_EMU_BLEP
+    , _blepOn(false)
+#endif
   {};
 
   /**
@@ -753,25 +2012,194 @@ public:
    * Initialize the object data. This needs to be called during setup() to initialize
    * new data for the class that cannot be done during the object creation.
    *
-   * Initializes the output pins.
+   * Resets the emulated IC to all tone dividers 0, all channels off and the
+   * noise shift register to its initial state.
    */
   void begin(void);
+  using MD_SN76489::begin;   // begin(clockHz) from the base class
+
+  /**
+   * Set the output sample rate.
+   *
+   * \param sampleRate the rate in Hz of the PCM samples produced.
+   */
+  void setSampleRate(uint32_t sampleRate);
+
+  /**
+   * Get the output sample rate.
+   *
+   * \return the rate in Hz of the PCM samples produced.
+   */
+  inline uint32_t getSampleRate(void) { return(_sampleRate); }
+
+  /**
+   * Render the next PCM sample.
+   *
+   * Advances the emulated IC by one sample period and returns the mix of 
+   * all 4 channels as a signed 16 bit value.
+   *
+   * \return the next PCM sample.
+   */
+  int16_t getSample(void);
+
+  /**
+   * Render a block of PCM samples.
+   *
+   * Advances the emulated IC by frames sample periods, writing the mix of
+   * all 4 channels as signed 16 bit values to the output buffer. Register
+   * writes take effect from the start of the next block.
+   *
+   * \param out    pointer to the output buffer, at least frames samples long.
+   * \param frames the number of samples to render.
+   */
+  void render(int16_t* out, size_t frames);
+
+#if SN_EMU_BLEP
+  /**
+   * Set band limited rendering mode.
+   *
+   * In band limited mode the output transitions of each channel are added to 
+   * the output as band limited steps, removing the aliasing produced by direct
+   * rendering at the sample rate. The output is delayed by BLEP_DELAY samples.
+   * 
+   * \param enable true to render band limited output, false for direct rendering.
+   */
+  void setBandLimited(bool enable);
+
+  /**
+   * Get band limited rendering mode.
+   *
+   * \return true if band limited rendering is enabled.
+   */
+  inline bool getBandLimited(void) { return(_blepOn); }
+
+  static const uint8_t BLEP_DELAY = 15;   ///< band limited output delay in samples
+#endif
+
+  /**
+   * Get the emulated IC registers.
+   *
+   * \return a reference to the register model decoded from the bytes sent to the emulator.
+   */
+  inline const MD_SN76489_Regs& getChipRegs(void) { return(_chip); }
 
 protected:
  /**
-  * Send a byte to the SN76489IC.
+  * Send a byte to the emulated IC.
   *
-  * Send a byte to the SN76489 IC using SPI protocol through a 74595 
-  * serial to parallel buffer. Uses the pin numbers passed through the 
-  * constructor to shift the data out to the buffer IC.
+  * Decodes the byte into the emulated IC registers.
   *
   * \param data  the data byte to transmit
   */
   void send(uint8_t data);
 
-private:
-  uint8_t _dat;  ///< SPI data out pin (MOSI)
-  uint8_t _ld;   ///< SPI load data pin (LD)
-  uint8_t _clk;  ///< SPI clock pin (CLK)
-  uint8_t _we;   ///< SN76489 Write Enable output pin (active low)
-};
\ No newline at end of file
+  /**
+   * Reset the noise shift register.
+   *
+   * The noise shift register is reset whenever the noise control register is written.
+   */
+  void resetNoise(void);
+
+  /**
+   * Get the period of a channel.
+   *
+   * \param chan  channel number [0..MAX_CHANNELS-1].
+   * \return the counter reload value for the channel in units of IC clock/16.
+   */
+  uint16_t period(uint8_t chan);
+
+  /**
+   * Clock the noise shift register.
+   *
+   * Called on each rising edge of the noise generator output.
+   */
+  void shiftNoise(void);
+
+  /**
+   * Render a block of PCM samples using scalar code.
+   *
+   * \param out    pointer to the output buffer, at least frames samples long.
+   * \param frames the number of samples to render.
+   */
+  void renderScalar(int16_t* out, size_t frames);
+
+#if SN_EMU_SIMD
+  /**
+   * Render a block of PCM samples using SSE2 vector code.
+   *
+   * \param out    pointer to the output buffer, at least frames samples long.
+   * \param frames the number of samples to render.
+   */
+  void renderSIMD(int16_t* out, size_t frames);
+#endif
+
+#if SN_EMU_BLEP
+  static const uint8_t BLEP_PHASE_BITS = 6;   ///< bits of sub-sample step position
+  static const uint8_t BLEP_PHASES = (1 << BLEP_PHASE_BITS);  ///< number of sub-sample kernels
+  static const uint8_t BLEP_WIDTH = 32;       ///< number of samples in each kernel
+  static const uint16_t BLEP_BLOCK = 256;     ///< maximum samples rendered in one pass
+  static const uint8_t BLEP_SCALE = 15;       ///< kernel taps are 1.15 fixed point
+
+  /**
+   * Render a block of PCM samples using band limited steps.
+   *
+   * \param out    pointer to the output buffer, at least frames samples long.
+   * \param frames the number of samples to render.
+   */
+  void renderBLEP(int16_t* out, size_t frames);
+
+  /**
+   * Get the current output level of a channel.
+   *
+   * \param chan  channel number [0..MAX_CHANNELS-1].
+   * \param vol   the output level for the channel attenuator setting.
+   * \return +vol if the channel output is high, -vol if low.
+   */
+  int32_t level(uint8_t chan, int32_t vol);
+
+  /**
+   * Get the time of a counter tick in the block being rendered.
+   *
+   * \param tick  the counter tick number in the block, 1 is the first tick.
+   * \param acc0  the fractional tick accumulator at the start of the block.
+   * \return the time in samples from the start of the block, 16.16 fixed point.
+   */
+  uint32_t stepTime(int32_t tick, uint32_t acc0);
+
+  /**
+   * Add a band limited step to the accumulation buffer.
+   *
+   * \param t      the time of the step in samples, 16.16 fixed point.
+   * \param delta  the change in output level.
+   */
+  void addStep(uint32_t t, int32_t delta);
+
+  /**
+   * Work out the band limited step kernel table.
+   *
+   * The table is shared by all the emulator objects and is only worked out once.
+   */
+  static void initKernel(void);
+
+  static int16_t _blepKernel[BLEP_PHASES][BLEP_WIDTH];  ///< band limited impulse for each sub-sample position, sums to 1.0
+  static bool _blepKernelOk;  ///< true if the kernel table has been worked out
+#endif
+
+  uint32_t _sampleRate;   ///< output sample rate in Hz
+  lfsrType_t _lfsrType;   ///< noise shift register variant
+  uint32_t _tickStep;     ///< IC clock/16 ticks per sample, 16.16 fixed point
+  uint32_t _tickAcc;      ///< fractional tick accumulator, 16.16 fixed point
+  MD_SN76489_Regs _chip;  ///< emulated IC registers
+  int32_t _count[MAX_CHANNELS]; ///< channel down counters
+  uint8_t _output;        ///< output bit for each channel (bit n = channel n)
+  uint16_t _lfsr;         ///< noise shift register
+#if SN_EMU_BLEP
+  bool _blepOn;           ///< band limited rendering is enabled
+  uint64_t _blepStep;     ///< samples per tick, 32.32 fixed point
+  int32_t _blepAmp[MAX_CHANNELS]; ///< channel output levels in the accumulation buffer
+  int32_t _blepSum;       ///< integrator of the accumulation buffer
+  int32_t _blepBuf[BLEP_BLOCK + BLEP_WIDTH]; ///< accumulation buffer of level changes
+#endif
+};
+
+#include "MD_SN76489_VGM.h"
@@ -7,36 +7,121 @@ See header file for copyright and licensing comments.
 
 /**
  * \file
- * \brief Derived class MD_SN76489_Direct functions
+ * \brief Derived class MD_SN76489_Direct transport functions
  */
-void MD_SN76489_Direct::begin(void)
+
+#if SN_FAST_IO
+// Read-modify-write of a port register with interrupts locked out, as
+// the store through a pointer is not atomic on the AVR.
+#define PORT_RMW(r, clr, set) { uint8_t sreg = SREG; cli(); *(r) = (*(r) & ~(clr)) | (set); SREG = sreg; }
+#endif
+
+void MD_SN76489_DirectBus::begin(void)
 {
   // Set all pins to outputs
   for (int8_t i = 0; i < DATA_BITS; i++)
     pinMode(_D[i], OUTPUT);
   pinMode(_we, OUTPUT);
+  if (_rdy != MD_SN76489::NO_PIN)
+    pinMode(_rdy, INPUT_PULLUP);
+
+#if SN_FAST_IO
+  // Work out which port each data pin is on and group them
+  // so that each port is written only once in send()
+  _portCount = 0;
+  _portDirect = true;
+  for (uint8_t i = 0; i < DATA_BITS; i++)
+  {
+    volatile uint8_t *reg = portOutputRegister(digitalPinToPort(_D[i]));
+    uint8_t p;
+
+    for (p = 0; p < _portCount; p++)
+      if (_port[p].reg == reg) break;
+
+    if (p == _portCount)    // new port
+    {
+      _port[p].reg = reg;
+      _port[p].mask = 0;
+      _portCount++;
+    }
 
-  // Call the base class
-  MD_SN76489::begin();
+    _pinPort[i] = p;
+    _pinMask[i] = digitalPinToBitMask(_D[i]);
+    _port[p].mask |= _pinMask[i];
+    _portDirect &= (_pinMask[i] == (0x80 >> i));  // D0 is the MSB
+  }
+  _portDirect &= (_portCount == 1);
+
+  _weReg = portOutputRegister(digitalPinToPort(_we));
+  _weMask = digitalPinToBitMask(_we);
+  if (_rdy != MD_SN76489::NO_PIN)
+  {
+    _rdyReg = portInputRegister(digitalPinToPort(_rdy));
+    _rdyMask = digitalPinToBitMask(_rdy);
+  }
+#endif
 }
 
-void MD_SN76489_Direct::send(uint8_t data)
+void MD_SN76489_DirectBus::send(const uint8_t* data, size_t len, uint8_t writeUs)
 {
-  // DEBUGX("\nsend 0x", data);
+#if SN_FAST_IO
+  PORT_RMW(_weReg, 0, _weMask);   // WE HIGH
 
+  for (size_t n = 0; n < len; n++)
+  {
+    // DEBUGX("\nsend 0x", data[n]);
+
+    // Set the data pins to current value
+    if (_portDirect)
+      *_port[0].reg = data[n];
+    else
+    {
+      uint8_t v[ARRAY_SIZE(_port)] = { 0 };
+
+      // build the value for each port ...
+      for (uint8_t i = 0; i < DATA_BITS; i++)
+        if (data[n] & (0x80 >> i))
+          v[_pinPort[i]] |= _pinMask[i];
+
+      // ... and write each port once
+      for (uint8_t p = 0; p < _portCount; p++)
+        PORT_RMW(_port[p].reg, _port[p].mask, v[p]);
+    }
+
+    // Toggle !WE LOW then HIGH to latch it in the IC
+    PORT_RMW(_weReg, _weMask, 0);   // WE LOW
+    if (_rdy == MD_SN76489::NO_PIN)
+      delayMicroseconds(writeUs);
+    else
+    {
+      // wait for READY to be released, with a timeout
+      uint32_t timeStart = micros();
+
+      while (!(*_rdyReg & _rdyMask) && (micros() - timeStart < 2 * writeUs))
+        ;  // wait
+    }
+    PORT_RMW(_weReg, 0, _weMask);   // WE HIGH
+  }
+#else
   digitalWrite(_we, HIGH);
 
-  // Set the data pins to current value
-  for (int8_t i = DATA_BITS - 1; i >= 0; i--)
+  for (size_t n = 0; n < len; n++)
   {
-    uint8_t v = (data & bit(i)) ? HIGH : LOW;
-    uint8_t p = DATA_BITS - i - 1;
-    // DEBUG("[", p);  DEBUG(":", v);  DEBUGS("]");
-    digitalWrite(_D[p], v);
-  }
+    // DEBUGX("\nsend 0x", data[n]);
 
-  // Toggle !WE LOW then HIGH to latch it in the IC
-  digitalWrite(_we, LOW);
-  delayMicroseconds(10);    // 4Mhz clock means 32 cycles for load are about 8us
-  digitalWrite(_we, HIGH);
+    // Set the data pins to current value
+    for (int8_t i = DATA_BITS - 1; i >= 0; i--)
+    {
+      uint8_t v = (data[n] & bit(i)) ? HIGH : LOW;
+      uint8_t p = DATA_BITS - i - 1;
+      // DEBUG("[", p);  DEBUG(":", v);  DEBUGS("]");
+      digitalWrite(_D[p], v);
+    }
+
+    // Toggle !WE LOW then HIGH to latch it in the IC
+    digitalWrite(_we, LOW);
+    MD_SN76489::writeWait(_rdy, writeUs);
+    digitalWrite(_we, HIGH);
+  }
+#endif
 }
@@ -0,0 +1,414 @@
+/*
+MD_SN76489 - Library for using a SN74689 sound generator
+
+See header file for copyright and licensing comments.
+*/
+#include <MD_SN76489.h>
+#if SN_EMU_SIMD
+#include <emmintrin.h>
+#endif
+#if SN_EMU_BLEP
+#include <math.h>
+#endif
+
+/**
+ * \file
+ * \brief Derived class MD_SN76489_Emu functions
+ */
+
+// Output level for each attenuator setting, 2dB per step. 
+// 4 channels at full volume add up to just under the int16_t limit.
+static const int16_t PROGMEM volTable[16] =
+{
+  8191, 6507, 5168, 4105, 3261, 2590, 2057, 1634,
+  1298, 1031,  819,  650,  517,  410,  326,    0
+};
+
+// Noise channel period for each noise shift rate setting (rate 3 uses tone 2)
+static const uint16_t PROGMEM noisePeriod[3] = { 0x10, 0x20, 0x40 };
+
+#if SN_EMU_BLEP
+int16_t MD_SN76489_Emu::_blepKernel[BLEP_PHASES][BLEP_WIDTH];
+bool MD_SN76489_Emu::_blepKernelOk = false;
+#endif
+
+void MD_SN76489_Emu::begin(void)
+{
+  // Reset the emulated IC to a known state - tone dividers 0, 
+  // attenuators off, noise rate 0
+  const uint8_t init[] = { 0x80, 0x00, 0x9f, 0xa0, 0x00, 0xbf, 0xc0, 0x00, 0xdf, 0xe0, 0xff };
+
+  _chip.reset();
+  for (uint8_t i = 0; i < ARRAY_SIZE(init); i++)
+    _chip.decode(init[i]);
+
+  for (uint8_t i = 0; i < MAX_CHANNELS; i++)
+    _count[i] = 0;
+  _output = 0;
+  _tickAcc = 0;
+  resetNoise();
+  setSampleRate(_sampleRate);
+#if SN_EMU_BLEP
+  if (_blepOn)
+  {
+    _blepOn = false;
+    setBandLimited(true);
+  }
+#endif
+
+  // Call the base class
+  MD_SN76489::begin();
+}
+
+void MD_SN76489_Emu::setSampleRate(uint32_t sampleRate)
+{
+  if (sampleRate == 0)
+    return;
+
+  _sampleRate = sampleRate;
+  // the counters are clocked at the IC clock/16
+  _tickStep = (uint32_t)(((uint64_t)_clockHz << 12) / _sampleRate);  // << 16 >> 4
+#if SN_EMU_BLEP
+  _blepStep = ((uint64_t)1 << 48) / _tickStep;
+#endif
+}
+
+void MD_SN76489_Emu::send(uint8_t data)
+{
+  _chip.decode(data);
+
+  // writing the noise register resets the shift register
+  if (_chip.getLatched() == MD_SN76489_Regs::NOISE_REG)
+    resetNoise();
+}
+
+void MD_SN76489_Emu::resetNoise(void)
+{
+  _lfsr = (_lfsrType == LFSR_SEGA) ? 0x8000 : 0x4000;
+}
+
+uint16_t MD_SN76489_Emu::period(uint8_t chan)
+{
+  uint16_t p;
+
+  if (chan == NOISE_CHANNEL)
+  {
+    uint8_t rate = _chip.get(MD_SN76489_Regs::NOISE_REG) & 0x3;
+
+    p = (rate == 3) ? period(2) : pgm_read_word(&noisePeriod[rate]);
+  }
+  else
+  {
+    p = _chip.get(chan << 1);
+    if (p == 0) p = 0x400;    // 0 behaves as the maximum divider
+  }
+
+  return(p);
+}
+
+void MD_SN76489_Emu::shiftNoise(void)
+{
+  uint16_t fb;
+
+  if (_chip.get(MD_SN76489_Regs::NOISE_REG) & 0x4)    // white noise
+  {
+    if (_lfsrType == LFSR_SEGA)
+      fb = ((_lfsr >> 0) ^ (_lfsr >> 3)) & 1;
+    else
+      fb = ((_lfsr >> 0) ^ (_lfsr >> 1)) & 1;
+  }
+  else      // periodic noise
+    fb = _lfsr & 1;
+
+  _lfsr = (_lfsr >> 1) | (fb << ((_lfsrType == LFSR_SEGA) ? 15 : 14));
+}
+
+int16_t MD_SN76489_Emu::getSample(void)
+{
+  int16_t s;
+
+  render(&s, 1);
+
+  return(s);
+}
+
+void MD_SN76489_Emu::render(int16_t* out, size_t frames)
+{
+#if SN_EMU_BLEP
+  if (_blepOn)
+  {
+    renderBLEP(out, frames);
+    return;
+  }
+#endif
+#if SN_EMU_SIMD
+  renderSIMD(out, frames);
+#else
+  renderScalar(out, frames);
+#endif
+}
+
+void MD_SN76489_Emu::renderScalar(int16_t* out, size_t frames)
+{
+  int32_t p[MAX_CHANNELS];
+  int16_t v[MAX_CHANNELS];
+
+  // registers are fixed for the block, so work out the settings once
+  for (uint8_t chan = 0; chan < MAX_CHANNELS; chan++)
+  {
+    p[chan] = period(chan);
+    v[chan] = pgm_read_word(&volTable[_chip.get((chan << 1) + 1) & 0xf]);
+  }
+
+  for (size_t i = 0; i < frames; i++)
+  {
+    int32_t mix = 0;
+
+    // work out how many counter ticks in this sample
+    _tickAcc += _tickStep;
+    int32_t ticks = _tickAcc >> 16;
+    _tickAcc &= 0xffff;
+
+    for (uint8_t chan = 0; chan < MAX_CHANNELS; chan++)
+    {
+      // count down and toggle the channel output each time the counter expires
+      _count[chan] -= ticks;
+      while (_count[chan] <= 0)
+      {
+        _count[chan] += p[chan];
+        _output ^= bit(chan);
+
+        // noise shifts on the rising edge of its square wave
+        if (chan == NOISE_CHANNEL && (_output & bit(chan)))
+          shiftNoise();
+      }
+
+      bool high = (chan == NOISE_CHANNEL) ? (_lfsr & 1) : (_output & bit(chan));
+
+      mix += high ? v[chan] : -v[chan];
+    }
+
+    out[i] = (int16_t)mix;
+  }
+}
+
+#if SN_EMU_SIMD
+void MD_SN76489_Emu::renderSIMD(int16_t* out, size_t frames)
+// One 32 bit lane per channel, lane 3 is the noise channel.
+// Output levels are kept as lane masks (all ones = high).
+{
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i TONES = _mm_set_epi32(0, -1, -1, -1);
+  const __m128i NOISE = _mm_set_epi32(-1, 0, 0, 0);
+
+  __m128i cnt = _mm_loadu_si128((const __m128i*)_count);
+  __m128i per = _mm_set_epi32(period(3), period(2), period(1), period(0));
+  __m128i vol = _mm_set_epi32(pgm_read_word(&volTable[_chip.get(7) & 0xf]),
+                              pgm_read_word(&volTable[_chip.get(5) & 0xf]),
+                              pgm_read_word(&volTable[_chip.get(3) & 0xf]),
+                              pgm_read_word(&volTable[_chip.get(1) & 0xf]));
+  __m128i lvl = _mm_set_epi32((_output & bit(3)) ? -1 : 0, (_output & bit(2)) ? -1 : 0,
+                              (_output & bit(1)) ? -1 : 0, (_output & bit(0)) ? -1 : 0);
+
+  for (size_t i = 0; i < frames; i++)
+  {
+    // work out how many counter ticks in this sample
+    _tickAcc += _tickStep;
+    cnt = _mm_sub_epi32(cnt, _mm_set1_epi32(_tickAcc >> 16));
+    _tickAcc &= 0xffff;
+
+    // reload and toggle all the expired counters together
+    for (;;)
+    {
+      __m128i expired = _mm_cmplt_epi32(cnt, ONE);
+      int lanes = _mm_movemask_ps(_mm_castsi128_ps(expired));
+
+      if (lanes == 0) break;
+
+      cnt = _mm_add_epi32(cnt, _mm_and_si128(expired, per));
+      lvl = _mm_xor_si128(lvl, expired);
+
+      // noise shifts on the rising edge of its square wave
+      if ((lanes & bit(NOISE_CHANNEL)) && (_mm_movemask_ps(_mm_castsi128_ps(lvl)) & bit(NOISE_CHANNEL)))
+        shiftNoise();
+    }
+
+    // the noise channel output is the shift register output
+    __m128i high = _mm_and_si128(lvl, TONES);
+    if (_lfsr & 1)
+      high = _mm_or_si128(high, NOISE);
+
+    // +vol for high and -vol for low, then add across the lanes
+    __m128i low = _mm_xor_si128(high, _mm_set1_epi32(-1));
+    __m128i s = _mm_sub_epi32(_mm_xor_si128(vol, low), low);
+
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    out[i] = (int16_t)_mm_cvtsi128_si32(s);
+  }
+
+  // save the channel state for the next block
+  _mm_storeu_si128((__m128i*)_count, cnt);
+  _output = _mm_movemask_ps(_mm_castsi128_ps(lvl));
+}
+#endif
+
+#if SN_EMU_BLEP
+void MD_SN76489_Emu::initKernel(void)
+// Windowed sinc impulse at each sub-sample position, with the Blackman 
+// window over BLEP_WIDTH samples and cut off at 0.4 of the sample rate.
+// The taps of each kernel are scaled to add up to exactly 1.0 so that 
+// the integrated steps never drift from the true output level.
+{
+  const double FC = 0.4;
+  const double PI_RAD = 3.14159265358979323846;  // Arduino.h defines PI
+
+  if (_blepKernelOk)
+    return;
+
+  for (uint8_t ph = 0; ph < BLEP_PHASES; ph++)
+  {
+    double h[BLEP_WIDTH];
+    double sum = 0.0;
+    int32_t total = 0;
+    uint8_t peak = 0;
+
+    for (uint8_t k = 0; k < BLEP_WIDTH; k++)
+    {
+      // distance from the centre of the impulse, in samples
+      double x = k - BLEP_DELAY - (ph + 0.5) / BLEP_PHASES;
+      double w = 0.42 + 0.5 * cos(PI_RAD * x / (BLEP_WIDTH / 2)) + 0.08 * cos(2 * PI_RAD * x / (BLEP_WIDTH / 2));
+
+      h[k] = 2 * FC * w * ((x == 0.0) ? 1.0 : sin(2 * PI_RAD * FC * x) / (2 * PI_RAD * FC * x));
+      sum += h[k];
+    }
+
+    for (uint8_t k = 0; k < BLEP_WIDTH; k++)
+    {
+      _blepKernel[ph][k] = (int16_t)lround(h[k] * (1 << BLEP_SCALE) / sum);
+      total += _blepKernel[ph][k];
+      if (_blepKernel[ph][k] > _blepKernel[ph][peak]) peak = k;
+    }
+    _blepKernel[ph][peak] += (1 << BLEP_SCALE) - total;   // rounding error
+  }
+
+  _blepKernelOk = true;
+}
+
+void MD_SN76489_Emu::setBandLimited(bool enable)
+{
+  if (enable == _blepOn)
+    return;
+
+  _blepOn = enable;
+  if (!_blepOn)
+    return;
+
+  initKernel();
+
+  // start with the current output levels already in the integrator
+  _blepSum = 0;
+  for (uint8_t chan = 0; chan < MAX_CHANNELS; chan++)
+  {
+    _blepAmp[chan] = level(chan, pgm_read_word(&volTable[_chip.get((chan << 1) + 1) & 0xf]));
+    _blepSum += _blepAmp[chan];
+  }
+  _blepSum <<= BLEP_SCALE;
+  memset(_blepBuf, 0, sizeof(_blepBuf));
+}
+
+int32_t MD_SN76489_Emu::level(uint8_t chan, int32_t vol)
+{
+  bool high = (chan == NOISE_CHANNEL) ? (_lfsr & 1) : (_output & bit(chan));
+
+  return(high ? vol : -vol);
+}
+
+uint32_t MD_SN76489_Emu::stepTime(int32_t tick, uint32_t acc0)
+{
+  // counters that expired before this block change at the start of the block
+  if (tick <= 0)
+    return(0);
+
+  return((uint32_t)(((((uint64_t)tick << 16) - acc0) * _blepStep) >> 32));
+}
+
+void MD_SN76489_Emu::addStep(uint32_t t, int32_t delta)
+{
+  const int16_t* k = _blepKernel[(t >> (16 - BLEP_PHASE_BITS)) & (BLEP_PHASES - 1)];
+  int32_t* b = &_blepBuf[t >> 16];
+
+  for (uint8_t i = 0; i < BLEP_WIDTH; i++)
+    b[i] += delta * k[i];
+}
+
+void MD_SN76489_Emu::renderBLEP(int16_t* out, size_t frames)
+// Rather than counting down sample by sample, the counter ticks in the 
+// pass are worked out up front and each channel is stepped from one 
+// transition to the next. Transitions that do not change the output level
+// (eg, a channel that is turned off) cost only the counter reload.
+{
+  while (frames > 0)
+  {
+    size_t n = (frames < BLEP_BLOCK) ? frames : BLEP_BLOCK;
+    uint32_t acc0 = _tickAcc;
+    uint64_t accEnd = acc0 + (uint64_t)_tickStep * n;
+    int32_t ticks = (int32_t)(accEnd >> 16);
+
+    for (uint8_t chan = 0; chan < MAX_CHANNELS; chan++)
+    {
+      int32_t p = period(chan);
+      int32_t v = pgm_read_word(&volTable[_chip.get((chan << 1) + 1) & 0xf]);
+      int32_t c = _count[chan];
+      int32_t a;
+
+      // volume changes take effect from the start of the block
+      a = level(chan, v);
+      if (a != _blepAmp[chan])
+      {
+        addStep(0, a - _blepAmp[chan]);
+        _blepAmp[chan] = a;
+      }
+
+      // toggle the output each time the counter expires in this pass
+      while (c <= ticks)
+      {
+        _output ^= bit(chan);
+
+        // noise shifts on the rising edge of its square wave
+        if (chan == NOISE_CHANNEL && (_output & bit(chan)))
+          shiftNoise();
+
+        a = level(chan, v);
+        if (a != _blepAmp[chan])
+        {
+          addStep(stepTime(c, acc0), a - _blepAmp[chan]);
+          _blepAmp[chan] = a;
+        }
+        c += p;
+      }
+      _count[chan] = c - ticks;
+    }
+
+    // integrate the level changes to give the output samples
+    for (size_t i = 0; i < n; i++)
+    {
+      int32_t s;
+
+      _blepSum += _blepBuf[i];
+      s = (_blepSum + (1 << (BLEP_SCALE - 1))) >> BLEP_SCALE;
+      if (s > INT16_MAX) s = INT16_MAX;
+      if (s < INT16_MIN) s = INT16_MIN;
+      out[i] = (int16_t)s;
+    }
+
+    // move the kernel tails to the start of the buffer for the next pass
+    memmove(_blepBuf, &_blepBuf[n], BLEP_WIDTH * sizeof(_blepBuf[0]));
+    memset(&_blepBuf[BLEP_WIDTH], 0, n * sizeof(_blepBuf[0]));
+
+    _tickAcc = (uint32_t)(accEnd & 0xffff);
+    out += n;
+    frames -= n;
+  }
+}
+#endif
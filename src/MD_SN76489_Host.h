@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * \file
+ * \brief Arduino API stand-ins for building the library on a host computer
+ *
+ * This header is included by MD_SN76489.h when the library is not compiled
+ * by the Arduino build system (ARDUINO is not defined). It provides just
+ * enough of the Arduino API for the library to build with a standard C++
+ * compiler, so that the software emulator (MD_SN76489_Emu) and the library
+ * logic can be used and tested on a host computer.
+ *
+ * Time is taken from the host steady clock. Digital I/O and SPI functions
+ * do nothing.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+typedef uint8_t byte;   ///< Arduino byte type
+
+#define HIGH  0x1       ///< Digital pin high
+#define LOW   0x0       ///< Digital pin low
+
+#define INPUT         0x0   ///< Pin mode input
+#define OUTPUT        0x1   ///< Pin mode output
+#define INPUT_PULLUP  0x2   ///< Pin mode input with pull-up
+
+#define LSBFIRST  0   ///< shiftOut() bit order
+#define MSBFIRST  1   ///< shiftOut() bit order
+
+#define bit(b) (1UL << (b))   ///< Value of bit b
+
+#define PROGMEM                                           ///< No separate program memory on the host
+#define pgm_read_byte(p)  (*(const uint8_t *)(p))         ///< Read byte from program memory
+#define pgm_read_word(p)  (*(const uint16_t *)(p))        ///< Read word from program memory
+#define pgm_read_dword(p) (*(const uint32_t *)(p))        ///< Read double word from program memory
+
+#define noInterrupts()  ///< No interrupts on the host
+#define interrupts()    ///< No interrupts on the host
+
+/**
+ * Time since the first call to any of the timing functions.
+ */
+inline std::chrono::steady_clock::duration hostElapsed(void)
+{
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  return(std::chrono::steady_clock::now() - start);
+}
+
+inline uint32_t millis(void) { return((uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(hostElapsed()).count()); }   ///< Milliseconds elapsed
+inline uint32_t micros(void) { return((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(hostElapsed()).count()); }   ///< Microseconds elapsed
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }                  ///< Wait ms milliseconds
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }  ///< Wait us microseconds
+
+inline void pinMode(uint8_t, uint8_t) {}          ///< Digital I/O does nothing
+inline void digitalWrite(uint8_t, uint8_t) {}     ///< Digital I/O does nothing
+inline int digitalRead(uint8_t) { return(HIGH); } ///< Digital inputs always read HIGH
+inline void shiftOut(uint8_t, uint8_t, uint8_t, uint8_t) {} ///< Digital I/O does nothing
+
+// SPI stand-ins
+static const uint8_t MOSI = 0;  ///< SPI data out pin
+static const uint8_t SCK = 0;   ///< SPI clock pin
+#define SPI_MODE0 0x00          ///< SPI mode
+
+/**
+ * SPI transaction settings stand-in.
+ */
+struct SPISettings
+{
+  SPISettings(void) {}                        ///< Default settings
+  SPISettings(uint32_t, uint8_t, uint8_t) {}  ///< Specified settings
+};
+
+/**
+ * SPI peripheral stand-in.
+ */
+struct SPIClass
+{
+  void begin(void) {}                             ///< Initialize SPI
+  void beginTransaction(const SPISettings&) {}    ///< Start transaction
+  void endTransaction(void) {}                    ///< End transaction
+  uint8_t transfer(uint8_t data) { return(data); }///< Transfer a byte
+};
+
+extern SPIClass SPI;  ///< The SPI peripheral, defined in MD_SN76489_SPI.cpp
@@ -0,0 +1,90 @@
+/*
+MD_SN76489 - Library for using a SN74689 sound generator
+
+See header file for copyright and licensing comments.
+*/
+#include <MD_SN76489.h>
+
+/**
+ * \file
+ * \brief Implements the MD_SN76489_Regs register model
+ */
+
+// 1RRRDDDD - 1=Latch+Data, RRR=Register, DDDD=Data1
+// 0XDDDDDD - 0=Data, X=Ignored, DDDDDD = Data2
+const uint8_t LATCH_CMD = 0x80;  ///< Latch register indicator
+const uint8_t DATA1_MASK = 0x0f; ///< 4-bits LSB of data
+const uint8_t DATA2_MASK = 0x3f; ///< 6-bits MSB of data
+
+void MD_SN76489_Regs::reset(void)
+{
+  for (uint8_t i = 0; i < REG_COUNT; i++)
+    _reg[i] = 0;
+  _knownLo = _knownHi = 0;
+  _latch = 0;
+}
+
+bool MD_SN76489_Regs::isKnown(uint8_t reg) const
+{
+  bool b = (_knownLo & bit(reg));
+
+  if (isTone(reg))
+    b = b && (_knownHi & bit(reg));
+
+  return(b);
+}
+
+bool MD_SN76489_Regs::isChanged(uint8_t data) const
+{
+  uint8_t reg = _latch;
+  uint16_t v;
+
+  if (data & LATCH_CMD)
+  {
+    reg = (data >> 4) & 0x7;
+    v = (_reg[reg] & ~DATA1_MASK) | (data & DATA1_MASK);
+  }
+  else if (isTone(reg))
+    v = (_reg[reg] & DATA1_MASK) | ((uint16_t)(data & DATA2_MASK) << 4);
+  else
+    v = data & DATA1_MASK;
+
+  return(!isKnown(reg) || (v != _reg[reg]));
+}
+
+bool MD_SN76489_Regs::decode(uint8_t data)
+{
+  bool wasKnown;
+  uint16_t v;
+
+  if (data & LATCH_CMD)
+  {
+    // latch the register and set the lower 4 bits
+    _latch = (data >> 4) & 0x7;
+    wasKnown = isKnown(_latch);
+    v = (_reg[_latch] & ~DATA1_MASK) | (data & DATA1_MASK);
+    _knownLo |= bit(_latch);
+  }
+  else
+  {
+    wasKnown = isKnown(_latch);
+    if (isTone(_latch))
+    {
+      // the upper 6 bits of a tone divider
+      v = (_reg[_latch] & DATA1_MASK) | ((uint16_t)(data & DATA2_MASK) << 4);
+      _knownHi |= bit(_latch);
+    }
+    else
+    {
+      // other registers only have 4 bits
+      v = data & DATA1_MASK;
+      _knownLo |= bit(_latch);
+    }
+  }
+
+  bool changed = !wasKnown || (v != _reg[_latch]);
+
+  _reg[_latch] = v;
+
+  return(changed);
+}
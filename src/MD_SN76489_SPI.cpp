@@ -7,33 +7,61 @@ See header file for copyright and licensing comments.
 
 /**
  * \file
- * \brief Derived class MD_SN76489_SPI functions
+ * \brief Derived class MD_SN76489_SPI transport functions
  */
-void MD_SN76489_SPI::begin(void)
+
+#ifndef ARDUINO
+SPIClass SPI;   // host build stand-in, see MD_SN76489_Host.h
+#endif
+
+void MD_SN76489_SPIBus::begin(void)
 {
-  pinMode(_dat, OUTPUT);
-  pinMode(_clk, OUTPUT);
+  if (_hwSPI)
+    SPI.begin();
+  else
+  {
+    pinMode(_dat, OUTPUT);
+    pinMode(_clk, OUTPUT);
+  }
   pinMode(_ld, OUTPUT);
   pinMode(_we, OUTPUT);
-
-  // Call the base class
-  MD_SN76489::begin();
+  if (_rdy != MD_SN76489::NO_PIN)
+    pinMode(_rdy, INPUT_PULLUP);
 }
 
-void MD_SN76489_SPI::send(uint8_t data)
+void MD_SN76489_SPIBus::send(const uint8_t* data, size_t len, uint8_t writeUs)
 {
-  // DEBUGX("\nsend 0x", data);
+  if (_hwSPI)
+    SPI.beginTransaction(_spiSettings);
 
   digitalWrite(_we, HIGH);
 
-  // Send out the data
-  digitalWrite(_ld, LOW); // load data
-  shiftOut(_dat, _clk, MSBFIRST, data); // send register
-  digitalWrite(_ld, HIGH);
-  
-  // Toggle !WE LOW then HIGH to latch it in the SN76489 IC
-  digitalWrite(_we, LOW);
-  delayMicroseconds(10);    // 4Mhz clock means 32 cycles for load are about 8us
-  digitalWrite(_we, HIGH);
+  for (size_t i = 0; i < len; i++)
+  {
+    // DEBUGX("\nsend 0x", data[i]);
+
+    // Send out the data
+    digitalWrite(_ld, LOW); // load data
+    if (_hwSPI)
+      SPI.transfer(data[i]);
+    else
+      shiftOut(_dat, _clk, MSBFIRST, data[i]); // send register
+    digitalWrite(_ld, HIGH);
+
+    // Toggle !WE LOW then HIGH to latch it in the SN76489 IC
+    digitalWrite(_we, LOW);
+    MD_SN76489::writeWait(_rdy, writeUs);
+    digitalWrite(_we, HIGH);
+  }
+
+  if (_hwSPI)
+    SPI.endTransaction();
 }
 
+void MD_SN76489_SPIBus::usingInterrupt(void)
+{
+#if defined(__AVR__)
+  if (_hwSPI)
+    SPI.usingInterrupt(255);  // the AVR SPI library masks all interrupts for a timer
+#endif
+}
@@ -0,0 +1,582 @@
+/*
+MD_SN76489 - Library for using a SN74689 sound generator
+
+See header file for copyright and licensing comments.
+*/
+#include <MD_SN76489.h>
+
+/**
+ * \file
+ * \brief Class MD_SN76489_VGM functions
+ */
+
+void MD_SN76489_VGMBlockSource::reset(void)
+{
+  _full[0] = _full[1] = false;
+  _next = 0;
+  _eof = false;
+  _first = true;
+  _stalls = 0;
+  _skip = 0;
+}
+
+void MD_SN76489_VGMBlockSource::fill(uint8_t b)
+{
+  _len[b] = _eof ? 0 : readBlock(_buf[b], BLOCK_SIZE);
+  _full[b] = true;
+  if (_len[b] < BLOCK_SIZE)
+    _eof = true;
+}
+
+size_t MD_SN76489_VGMBlockSource::read(const uint8_t* &data)
+{
+  uint8_t b = _next;
+
+  if (!_full[b])
+  {
+    // no idle time since the last block, read it now
+    if (!_first) _stalls++;
+    fill(b);
+  }
+
+  _first = false;
+  _full[b] = false;
+  _next = b ^ 1;
+
+  // after seek() the first block starts before the offset
+  if (_skip > _len[b]) _skip = _len[b];
+  data = _buf[b] + _skip;
+  _len[b] -= _skip;
+  _skip = 0;
+
+  return(_len[b]);
+}
+
+void MD_SN76489_VGMBlockSource::idle(void)
+{
+  // the buffer being played is _next ^ 1, so _next is free to fill
+  if (!_full[_next] && !_eof)
+    fill(_next);
+}
+
+bool MD_SN76489_VGMBlockSource::seek(uint32_t offset)
+{
+  uint16_t stalls = _stalls;
+  uint32_t pos = offset - (offset % BLOCK_SIZE);
+
+  if (!seekBlock(pos))
+    return(false);
+
+  reset();
+  _stalls = stalls;
+  _skip = offset - pos;
+
+  return(true);
+}
+
+size_t MD_SN76489_VGMMemory::read(const uint8_t* &data)
+{
+  uint32_t len = _len - _pos;
+
+  // size_t may be smaller than the data (eg, 16 bits on the AVR)
+  if ((size_t)len != len) len = (size_t)~0U;
+
+  data = _data + _pos;
+  _pos += len;
+
+  return(len);
+}
+
+bool MD_SN76489_VGMMemory::seek(uint32_t offset)
+{
+  if (offset > _len)
+    return(false);
+
+  _pos = offset;
+
+  return(true);
+}
+
+bool MD_SN76489_VGM::fill(void)
+{
+  size_t len = _src->read(_p);
+
+  _end = _p + len;
+  _endPos += len;
+  _pgm = _src->isProgmem();
+
+  return(len != 0);
+}
+
+bool MD_SN76489_VGM::jump(uint32_t offset)
+{
+  if (!_src->seek(offset))
+    return(false);
+
+  _p = _end = nullptr;
+  _endPos = offset;
+
+  return(true);
+}
+
+void MD_SN76489_VGM::skip(uint32_t n)
+{
+  while (n > 0)
+  {
+    if (_p == _end && !fill())
+      return;
+
+    uint32_t k = _end - _p;
+
+    if (k > n) k = n;
+    _p += k;
+    n -= k;
+  }
+}
+
+uint32_t MD_SN76489_VGM::readLE(uint8_t size)
+// All VGM integer values are unsigned little endian
+{
+  uint32_t v = 0;
+
+  for (uint8_t i = 0; i < size; i++)
+    v |= (uint32_t)(next() & 0xff) << (8 * i);
+
+  return(v);
+}
+
+bool MD_SN76489_VGM::start(MD_SN76489_VGMSource& src)
+{
+  _src = &src;
+  _p = _end = nullptr;
+  _endPos = 0;
+  _dataOffset = 0;
+  _playing = false;
+
+  // Read the parts of the header needed, skipping the rest
+  switch (readLE(4))
+  {
+  case VGM_IDENT:
+    _sns = false;
+    skip(HDR_VERSION - (HDR_IDENT + 4));
+    _version = readLE(4);
+    _clockHz = readLE(4) & 0x3fffffff;    // top bits are dual chip and T6W28 flags
+    skip(HDR_SAMPLES - (HDR_SN_CLOCK + 4));
+    _totalSamples = readLE(4);
+    _loopOffset = readLE(4);
+    _loopSamples = readLE(4);
+    skip(HDR_DATA - (HDR_LOOP_SAMPLES + 4));
+    _dataOffset = readLE(4);
+    skip(HDR_SIZE - (HDR_DATA + 4));
+
+    // the data offset is relative to its own header position from version 1.50
+    if (_version < 0x150 || _dataOffset == 0)
+      _dataOffset = HDR_SIZE;
+    else
+      _dataOffset += HDR_DATA;
+    if (_dataOffset < HDR_SIZE)
+      _dataOffset = 0;
+    else
+      skip(_dataOffset - HDR_SIZE);
+
+    // the loop offset is relative to its header position, 0 for no loop
+    if (_loopOffset != 0)
+      _loopOffset += HDR_LOOP;
+    break;
+
+  case SNS_IDENT:
+    _sns = true;
+    _version = SNS_IDENT >> 24;
+    _clockHz = readLE(4);
+    _totalSamples = readLE(4);
+    _loopOffset = readLE(4);
+    _loopSamples = readLE(4);
+    _frame = readLE(2);
+    _dataOffset = readLE(2);
+    if (_dataOffset < SNS_HDR_SIZE)
+      _dataOffset = 0;
+    else
+      skip(_dataOffset - SNS_HDR_SIZE);
+    break;
+
+  default:
+    return(false);
+  }
+
+  if (_dataOffset == 0)   // not valid, left as not started for seek()
+    return(false);
+  if (_loopOffset < _dataOffset || _loopSamples == 0 || _loopSamples > _totalSamples)
+    _loopOffset = 0;
+  _loopsLeft = _loops;
+  _looped = false;
+
+  _wCount = 0;
+  _samplePos = 0;
+  _seekOver = 0;
+  _callEnd = 0;
+  _skipping = false;
+  _timeSet = false;
+  _indexCount = 0;
+  _indexStep = _interval;
+  _playing = true;
+
+  return(true);
+}
+
+void MD_SN76489_VGM::stop(void)
+{
+  const uint8_t off[] = { 0x9f, 0xbf, 0xdf, 0xff };   // all attenuators off
+
+  _playing = false;
+  _wCount = 0;
+  _S.write(off, ARRAY_SIZE(off));
+}
+
+void MD_SN76489_VGM::setIndex(checkpoint_t* index, uint16_t size, uint32_t interval)
+{
+  _index = index;
+  _indexSize = (index == nullptr) ? 0 : size;
+  _indexCount = 0;
+  _interval = _indexStep = (interval == 0) ? 1 : interval;
+}
+
+void MD_SN76489_VGM::flush(void)
+{
+  if (_wCount != 0)
+  {
+    _S.write(_wBuf, _wCount);
+    _wCount = 0;
+  }
+}
+
+void MD_SN76489_VGM::put(uint8_t data)
+{
+  if (_skipping)
+    _regs.decode(data);
+  else
+  {
+    _wBuf[_wCount++] = data;
+    if (_wCount == ARRAY_SIZE(_wBuf))
+      flush();
+  }
+}
+
+void MD_SN76489_VGM::wait(uint32_t samples)
+// Move the due time on by the samples, keeping the fraction of a
+// microsecond so that the time follows the sample clock exactly.
+{
+  uint64_t t = ((uint64_t)samples * US_PER_SAMPLE) + _dueFrac;
+
+  _dueUs += (uint32_t)(t >> 24);
+  _dueFrac = (uint32_t)t & 0xffffff;
+}
+
+void MD_SN76489_VGM::end(void)
+// At the end of the data go back to the loop point, if there is one. A loop
+// with no waits in the data (whatever the header says) would be played 
+// again and again without time passing, so it is played only once.
+{
+  bool empty = _looped && (_samplePos == _totalSamples - _loopSamples);
+
+  _callEnd = 0;
+  if (_loopOffset != 0 && _loopsLeft != 0 && !empty && jump(_loopOffset))
+  {
+    if (_loopsLeft != LOOP_FOREVER)
+      _loopsLeft--;
+    _samplePos = _totalSamples - _loopSamples;
+    _looped = true;
+  }
+  else
+  {
+    flush();
+    stop();
+  }
+}
+
+void MD_SN76489_VGM::checkpoint(void)
+// Save the state if the position is far enough past the last checkpoint.
+// Positions are only ever saved in order, so the index stays sorted.
+{
+  if (_indexSize == 0 || _callEnd != 0 ||
+    (_indexCount != 0 && _samplePos < _index[_indexCount - 1].sample + _indexStep))
+    return;
+
+  if (_indexCount == _indexSize)
+  {
+    // full, keep every other checkpoint and double the interval
+    for (uint16_t i = 0; i < _indexSize / 2; i++)
+      _index[i] = _index[2 * i + 1];
+    _indexCount = _indexSize / 2;
+    _indexStep *= 2;
+    if (_indexCount != 0 && _samplePos < _index[_indexCount - 1].sample + _indexStep)
+      return;
+  }
+
+  checkpoint_t* cp = &_index[_indexCount++];
+
+  cp->sample = _samplePos;
+  cp->offset = filePos();
+  cp->regs = _skipping ? _regs : _S.getRegs();
+}
+
+void MD_SN76489_VGM::restore(const MD_SN76489_Regs& regs)
+// Write all the known registers, with volumes not yet set turned off,
+// and leave the same register latched.
+{
+  uint8_t buf[2 * MD_SN76489_Regs::REG_COUNT + 1];
+  uint8_t n = 0;
+
+  for (uint8_t r = 0; r < MD_SN76489_Regs::REG_COUNT; r++)
+  {
+    uint8_t latch = 0x80 | (r << 4);
+
+    if (regs.isKnown(r))
+    {
+      buf[n++] = latch | (regs.get(r) & 0x0f);
+      if (MD_SN76489_Regs::isTone(r))
+        buf[n++] = (regs.get(r) >> 4) & 0x3f;
+    }
+    else if (r & 1)   // attenuator
+      buf[n++] = latch | 0x0f;
+  }
+  if (regs.isKnown(regs.getLatched()))
+    buf[n++] = 0x80 | (regs.getLatched() << 4) | (regs.get(regs.getLatched()) & 0x0f);
+
+  _S.write(buf, n);
+}
+
+bool MD_SN76489_VGM::seek(uint32_t sample)
+{
+  checkpoint_t* cp = nullptr;
+
+  if (_src == nullptr || _dataOffset == 0 || sample >= _totalSamples)
+    return(false);
+
+  // the last checkpoint at or before the position
+  for (uint16_t i = _indexCount; i > 0; i--)
+    if (_index[i - 1].sample <= sample)
+    {
+      cp = &_index[i - 1];
+      break;
+    }
+
+  flush();
+  if (_playing && _samplePos <= sample && (cp == nullptr || cp->sample <= _samplePos))
+    _regs = _S.getRegs();   // carry on from here
+  else
+  {
+    if (!jump(cp == nullptr ? _dataOffset : cp->offset))
+      return(false);
+    _callEnd = 0;
+    _looped = false;
+    if (cp == nullptr)
+    {
+      _samplePos = 0;
+      _regs.reset();
+    }
+    else
+    {
+      _samplePos = cp->sample;
+      _regs = cp->regs;
+    }
+  }
+
+  // pass over the commands up to the position
+  _skipping = true;
+  _playing = true;
+  while (_playing && _samplePos < sample)
+  {
+    uint32_t w = command();
+
+    if (w != 0)
+    {
+      _samplePos += w;
+      checkpoint();
+    }
+  }
+  _skipping = false;
+
+  if (_playing)
+  {
+    restore(_regs);
+    _seekOver = _samplePos - sample;
+    _timeSet = false;
+  }
+
+  return(_playing);
+}
+
+uint32_t MD_SN76489_VGM::readVar(void)
+// Variable length number, 7 bits in each byte from the least significant,
+// with the top bit set in all but the last byte
+{
+  uint32_t v = 0;
+
+  for (uint8_t shift = 0; shift < 32; shift += 7)
+  {
+    int16_t b = next();
+
+    if (b < 0) break;
+    v |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) break;
+  }
+
+  return(v);
+}
+
+uint32_t MD_SN76489_VGM::commandSNS(void)
+{
+  // at the end of a repeated section, carry on after the repeat command
+  if (_callEnd != 0 && filePos() >= _callEnd)
+  {
+    _callEnd = 0;
+    jump(_callRet);
+  }
+
+  uint32_t pos = filePos();
+  int16_t cmd = next();
+
+  if (cmd >= SNS_LATCH)         // 1rrrdddd : latch byte written as it is
+    put(cmd);
+  else if (cmd >= SNS_DATA)     // 01dddddd : data byte
+    put(cmd & 0x3f);
+  else if (cmd >= SNS_WAIT_FRAMES && cmd < SNS_WAIT)
+    return(cmd * _frame);
+  else if (cmd == SNS_WAIT)
+    return(readVar());
+  else if (cmd > SNS_WAIT && cmd < SNS_REPEAT)
+    return(cmd - SNS_WAIT);
+  else if (cmd == SNS_REPEAT && _callEnd == 0)
+  {
+    uint32_t back = readVar();
+    uint32_t len = readVar();
+
+    // play the earlier section, which cannot itself contain a repeat
+    _callRet = filePos();
+    _callEnd = pos - back + len;
+    if (back > pos || !jump(pos - back))
+      end();
+  }
+  else    // end of the data, or not valid
+    end();
+
+  return(0);
+}
+
+uint32_t MD_SN76489_VGM::command(void)
+{
+  if (_sns)
+    return(commandSNS());
+
+  int16_t cmd = next();
+
+  switch (cmd)
+  {
+  case 0x50:  // 0x50 dd : PSG (SN76489/SN76496) write value dd
+    put(next());
+    break;
+
+  case 0x61:  // 0x61 nn nn : Wait n samples, n can range from 0 to 65535
+    return(readLE(2));
+
+  case 0x62:  // wait 735 samples (60th of a second)
+    return(735);
+
+  case 0x63:  // wait 882 samples (50th of a second)
+    return(882);
+
+  case 0x70 ... 0x7f: // 0x7n : wait n+1 samples, n can range from 0 to 15
+    return((cmd & 0x0f) + 1);
+
+  case 0x80 ... 0x8f: // 0x8n : YM2612 DAC write then wait n samples
+    return(cmd & 0x0f);
+
+  case 0x67:  // 0x67 0x66 tt ss ss ss ss : data block of size ss
+    skip(2);
+    skip(readLE(4));
+    break;
+
+  case 0x68:  // 0x68 0x66 cc oo oo oo dd dd dd ss ss ss : PCM RAM write
+    skip(11);
+    break;
+
+  // Commands for other ICs, skip the operands
+  case 0x30 ... 0x3f: // second PSG and reserved, 1 operand
+  case 0x4f:          // Game Gear stereo, 1 operand
+  case 0x94:          // stop DAC stream, 1 operand
+    skip(1);
+    break;
+
+  case 0x40 ... 0x4e: // 2 operands
+  case 0x51 ... 0x5f:
+  case 0xa0 ... 0xbf:
+    skip(2);
+    break;
+
+  case 0xc0 ... 0xdf: // 3 operands
+    skip(3);
+    break;
+
+  case 0x90 ... 0x91: // DAC stream set up, 4 operands
+  case 0x95:
+  case 0xe0 ... 0xff:
+    skip(4);
+    break;
+
+  case 0x92:  // DAC stream frequency
+    skip(5);
+    break;
+
+  case 0x93:  // DAC stream start
+    skip(10);
+    break;
+
+  case 0x66:  // 0x66 : end of sound data
+  case -1:    // end of the source data
+    end();
+    break;
+
+  default:    // unknown, no operands
+    break;
+  }
+
+  return(0);
+}
+
+bool MD_SN76489_VGM::poll(uint32_t now)
+{
+  if (!_playing)
+    return(false);
+
+  // the sample clock starts at the first call, after any part wait left by seek()
+  if (!_timeSet)
+  {
+    _dueUs = now;
+    _dueFrac = 0;
+    wait(_seekOver);
+    _seekOver = 0;
+    _timeSet = true;
+  }
+
+  // process all the commands that are due, even if we are running late
+  while (_playing && (int32_t)(now - _dueUs) >= 0)
+  {
+    uint32_t w = command();
+
+    if (w != 0)
+    {
+      flush();
+      wait(w);
+      _samplePos += w;
+      checkpoint();
+    }
+  }
+
+  flush();
+
+  // nothing more to do until the next command, let the source read ahead
+  if (_playing)
+    _src->idle();
+
+  return(_playing);
+}
@@ -0,0 +1,1046 @@
+#pragma once
+
+/**
+ * \file
+ * \brief Header file for the MD_SN76489 VGM music file player
+ *
+ * Included by MD_SN76489.h, so applications do not need to include it.
+ */
+
+#ifndef SN_VGM_BLOCK
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define SN_VGM_BLOCK 128  ///< Size of each MD_SN76489_VGMBlockSource buffer. See \ref pageCompileSwitch
+#else
+#define SN_VGM_BLOCK 512  ///< Size of each MD_SN76489_VGMBlockSource buffer. See \ref pageCompileSwitch
+#endif
+#endif
+
+#ifndef SN_VGZ_WINDOW
+#ifdef __AVR__
+#define SN_VGZ_WINDOW 1024  ///< Size of the MD_SN76489_VGZSource history window. See \ref pageCompileSwitch
+#else
+#define SN_VGZ_WINDOW 32768 ///< Size of the MD_SN76489_VGZSource history window. See \ref pageCompileSwitch
+#endif
+#endif
+
+/**
+\page pageVGM Playing VGM Files
+VGM Files
+---------
+VGM (Video Game Music) files are a log of the register writes made to the
+sound ICs of a game console, with the time between writes. Files for the
+SN76489 are available from https://vgmrips.net/packs/chip/sn76489 and the
+file format is described at https://vgmrips.net/wiki/VGM_Specification.
+
+The MD_SN76489_VGM class plays the SN76489 data in a VGM file to any
+MD_SN76489 object. The data is read from a byte source object derived from
+MD_SN76489_VGMSource, so the file can be on an SD card, in memory or
+anywhere else the application can read it from.
+
+The VGM header is read by start(). The VGM data is then played by calling
+poll() every time through loop(). poll() never waits - it sends all the
+register writes that are due and returns, so the rest of the application
+keeps running while the music plays.
+
+Timing
+------
+VGM wait commands are counted in samples at 44.1kHz. The player adds each
+wait to the time at which the next write is due, keeping the fraction of a
+microsecond, so the music stays locked to the sample clock for the whole
+file and no rounding error builds up. If poll() is called late, all the
+writes that are now due are sent straight away and playback carries on
+from the same sample clock, catching up on the time lost.
+
+Writes between two waits are sent to the IC together with write(const uint8_t*, size_t).
+
+poll(uint32_t) can be called with the time from an application time source,
+in microseconds. As for play(uint32_t), a 'virtual clock' together with
+MD_SN76489_Emu allows the music to be rendered faster than real time.
+
+Reading Files
+-------------
+Reading a file a byte at a time is slow, and a file system read in the 
+middle of a burst of register writes delays the writes enough to be heard.
+MD_SN76489_VGMBlockSource reads the file in blocks of SN_VGM_BLOCK bytes 
+(one SD card sector, see \ref pageCompileSwitch) into two buffers. While the 
+player works through one buffer, the other is filled by poll() when it has 
+nothing to send, ie, while a wait command is being timed. The application 
+derives a class from MD_SN76489_VGMBlockSource and implements readBlock() to
+read the file. The file is always read from the start in whole blocks, so 
+every read is sector aligned.
+
+Only if the player gets through a whole buffer without waiting (more than 
+SN_VGM_BLOCK bytes of data in one burst) is the file read while decoding 
+commands. These reads are counted by getStalls().
+
+Short files can be stored in program memory instead of on an SD card. The 
+MD_SN76489_VGMToH host tool (vgm2h in the library tools folder) converts a VGM 
+file into a header file with the data in a PROGMEM array, which is played with
+
+    MD_SN76489_VGMMemory src(vgmData, sizeof(vgmData), true);
+
+The player walks a pointer through the data where it is, with no copying 
+and no calls to the source for each byte. The same class plays a file held 
+in RAM or, on a host computer, a memory mapped file (see the MD_SN76489_VGMPlay
+tool, which renders a VGM file to a WAV file with MD_SN76489_Emu).
+
+Compressed Files
+----------------
+Most VGM files are distributed gzip compressed, with the extension .vgz. 
+MD_SN76489_VGZSource decompresses the data from another source as it is 
+played, so these files can be played without unzipping them first:
+
+    MD_SN76489_VGZSource vgz(file);   // file is the source of the .vgz data
+
+The data is decompressed into a history window of SN_VGZ_WINDOW bytes (see 
+\ref pageCompileSwitch), which is also the buffer the player reads from, and
+the next block is decompressed ahead in idle(). Data that is not compressed
+is passed straight through, so the same object plays .vgm and .vgz files. 
+The decoder needs about 800 bytes of RAM as well as the window, and up to
+650 bytes of stack.
+
+gzip uses a 32kB window, so a file may refer back to data up to 32kB before
+the current position. A smaller window can be used on processors without
+enough RAM, but only files that do not refer back further than the window 
+(eg, files that are smaller than the window when decompressed) can then be
+played. The player stops and isError() returns true if a file needs a 
+larger window or the data is not valid.
+
+Loops and Seeking
+-----------------
+Many VGM files have a loop point in the header. When the end of the data 
+is reached, play continues from the loop point, by default until stop() is
+called. setLoops() sets the number of times the loop is played again. The 
+source must support seek() to go back to the loop point: MD_SN76489_VGMMemory
+does, MD_SN76489_VGMBlockSource does if the application implements 
+seekBlock() and MD_SN76489_VGZSource does if the source it reads does.
+
+seek() moves the play position to any time in the file. Without an index, 
+the player passes over every command from the start of the data (without 
+sending them to the IC) to find the IC register values at the time. With 
+an array of checkpoints set by setIndex(), the player saves its state (the 
+time, file offset and IC registers) every few seconds as the file is first 
+played. seek() then starts from the nearest checkpoint before the time and
+only passes over the commands after it. Each checkpoint is 28 bytes, and a 
+small index covers any length of file as the checkpoints are spread out 
+when the index fills up.
+
+Optimizing VGM Files
+--------------------
+The MD_SN76489_VGMOpt host tool (vgmopt in the library tools folder) writes
+a copy of a VGM or VGZ file without the SN76489 writes that do not change
+the IC, with tone registers that only change their lower 4 bits written 
+with a latch byte alone (or their upper 6 bits with a data byte alone, if
+still latched), and with runs of waits merged. The new file plays the same,
+with less time spent writing to the IC and less data to read. The tool 
+prints the bytes, writes and wait commands saved. A file that would be no
+smaller is written unchanged. Files logged from games, which often write 
+every register every frame, gain the most. Files that only write changes
+already, such as the examples in the VGM_Player_CLI folder, gain little.
+
+Compact Stream Files
+--------------------
+VGM files log every write made by the game, including many that do not 
+change a register, and often repeat the same frames of music many times.
+The MD_SN76489_VGMToSNS host tool (vgm2sns in the library tools folder) 
+converts a VGM or VGZ file into a compact stream (.sns) file, which is 
+played by MD_SN76489_VGM from any source in the same way as a VGM file. 
+The player finds the format from the first bytes of the file. Compact 
+stream files are typically 2 to 4 times smaller than the VGM file they 
+came from, and much smaller for files logged from games, and can be built
+into a sketch with vgm2h or played from an SD card. They need no extra 
+buffers to play: the decoder only adds a few bytes to the player. Each 
+frame usually takes a little longer to decode than from the VGM file, as 
+playing a repeat moves the read position in the source, so the smaller 
+file is traded for some CPU time.
+
+The file has a 24 byte header, with values stored little endian
+
+| Offset | Size | Contents                                              |
+|--------|------|-------------------------------------------------------|
+|   0    |  4   | "SNS" and the format version (1)                      |
+|   4    |  4   | SN76489 clock in Hz                                   |
+|   8    |  4   | total samples (44.1kHz) played once through           |
+|  12    |  4   | offset of the loop point from the start, 0 for none   |
+|  16    |  4   | samples in the loop                                   |
+|  20    |  2   | samples in a frame, for the short wait commands       |
+|  22    |  2   | offset of the data from the start                     |
+
+followed by the data, where each byte is
+
+| Byte      | Command                                                    |
+|-----------|------------------------------------------------------------|
+| 1rrrdddd  | latch byte written to the IC                               |
+| 01dddddd  | data byte written to the IC                                |
+| 0x00      | end of the data                                            |
+| 0x01-0x0f | wait 1 to 15 frames                                        |
+| 0x10 n    | wait n samples                                             |
+| 0x11-0x1f | wait 1 to 15 samples                                       |
+| 0x20 b n  | play the n bytes starting b bytes before this command again|
+
+The numbers n and b are variable length, 7 bits in each byte from the least
+significant, with the top bit set in all but the last byte. A repeated 
+section of the data does not contain a repeat command. The player goes to
+a repeated section and back with seek() on the source, which costs nothing
+for data in memory but may read a block each time from a file. 
+
+Only the register writes that change the IC are in the file, with tone 
+registers that only change their lower 4 bits written with a latch byte 
+alone. Writes in the loop are kept if they change the IC either the first
+time through or when the loop is played again.
+
+Only the data for the first SN76489 is played. Writes for a second SN76489
+and for other sound ICs in the same file are skipped.
+
+Recording VGM Files
+-------------------
+MD_SN76489_VGMRecorder records the writes made by the library as a VGM 1.50
+file. The recorder is a MD_SN76489 object that wraps the object for the 
+hardware (or MD_SN76489_Emu), so the sketch uses the recorder in place of 
+the wrapped object and everything it plays is both sent to the IC and 
+recorded. The file data is written to an object derived from 
+MD_SN76489_VGMSink, either MD_SN76489_VGMBuffer for a recording in memory 
+or a class written by the application for a file or serial port.
+
+The recording runs from start() to stop(). Each byte sent is written as a
+0x50 command, preceded by a 0x61 wait command for the time since the last 
+write, so the recording plays with the same timing as the original. The 
+time is read from micros() or, after setTime(), from a 'virtual clock' 
+given by the application. With a virtual clock the same music always gives
+the same file, which can be compared with a known good recording to test 
+changes to the library or used to count the writes and the bus time.
+
+With SN_TIMER_PLAY the envelope writes are sent from the timer interrupt,
+so the sink write() is called from the interrupt and must be quick and 
+safe to call there (eg, into a buffer).
+*/
+
+/**
+ * Base class for the source of VGM file data
+ *
+ * The player reads the data a block at a time, so the source is called
+ * once for each block rather than for each byte. Derived classes implement
+ * read() for the storage used.
+ */
+class MD_SN76489_VGMSource
+{
+public:
+ /**
+  * Get the next block of data.
+  *
+  * Make the next block of file data available to the player. The data
+  * pointed to must remain valid until the next call to read().
+  *
+  * \param data  set to point to the first byte of the block.
+  * \return the number of bytes in the block, 0 at the end of the data.
+  */
+  virtual size_t read(const uint8_t* &data) = 0;
+
+ /**
+  * Use idle time.
+  *
+  * Called by the player when it has nothing to do until the next command 
+  * is due. The source can use this time to get the next block of data 
+  * ready. The base class method does nothing.
+  */
+  virtual void idle(void) {};
+
+ /**
+  * Check if the data is in program memory.
+  *
+  * On the AVR, data in program memory (PROGMEM) must be read with 
+  * pgm_read_byte(). Checked by the player after each read(). The base 
+  * class method returns false.
+  *
+  * \return true if the data pointers returned by read() point to program memory.
+  */
+  virtual bool isProgmem(void) { return(false); }
+
+ /**
+  * Move to a new position in the data.
+  *
+  * The next call to read() returns the data starting at the offset. Used 
+  * by the player to go back to the loop point and to seek(). The base 
+  * class method returns false.
+  *
+  * \param offset  the offset from the start of the file.
+  * \return true if the source has moved to the offset.
+  */
+  virtual bool seek(uint32_t offset) { (void)offset; return(false); }
+
+ /**
+  * Class Destructor.
+  */
+  virtual ~MD_SN76489_VGMSource(void) {};
+};
+
+/**
+ * VGM data source for a file held in memory
+ *
+ * The whole file is handed to the player as one block, so the data is 
+ * played where it is without being copied. The data can be in RAM, in 
+ * program memory (PROGMEM) or, on a host computer, a memory mapped file.
+ */
+class MD_SN76489_VGMMemory: public MD_SN76489_VGMSource
+{
+public:
+ /**
+  * Class Constructor.
+  *
+  * \param data    pointer to the first byte of the VGM file.
+  * \param len     the number of bytes in the file.
+  * \param progmem true if the data is in program memory (PROGMEM), default false.
+  */
+  MD_SN76489_VGMMemory(const uint8_t* data, uint32_t len, bool progmem = false) :
+    _data(data), _len(len), _pos(0), _progmem(progmem)
+  {};
+
+ /**
+  * Go back to the start of the data.
+  *
+  * Must be called before the data is passed to MD_SN76489_VGM::start() 
+  * again to replay it.
+  */
+  inline void reset(void) { _pos = 0; }
+
+ /**
+  * Get the next block of data.
+  *
+  * Hands the rest of the data to the player as one block.
+  *
+  * \param data  set to point to the first byte of the block.
+  * \return the number of bytes in the block, 0 at the end of the data.
+  */
+  size_t read(const uint8_t* &data);
+
+ /**
+  * Check if the data is in program memory.
+  *
+  * \return true if the data is in program memory.
+  */
+  bool isProgmem(void) { return(_progmem); }
+
+ /**
+  * Move to a new position in the data.
+  *
+  * \param offset  the offset from the start of the data.
+  * \return true if the offset is in the data.
+  */
+  bool seek(uint32_t offset);
+
+private:
+  const uint8_t* _data; ///< the VGM file data
+  uint32_t _len;        ///< number of bytes of data
+  uint32_t _pos;        ///< offset of the next byte to hand over
+  bool _progmem;        ///< true if the data is in program memory
+};
+
+/**
+ * Base class for a double buffered VGM data source
+ *
+ * The data is read in blocks of BLOCK_SIZE bytes into two buffers. The 
+ * buffer not being played is filled during idle(). Derived classes implement
+ * readBlock() to read the storage used (eg, a file on an SD card).
+ */
+class MD_SN76489_VGMBlockSource: public MD_SN76489_VGMSource
+{
+public:
+  static const uint16_t BLOCK_SIZE = SN_VGM_BLOCK;  ///< bytes read by each readBlock()
+
+ /**
+  * Class Constructor.
+  */
+  MD_SN76489_VGMBlockSource(void) { reset(); };
+
+ /**
+  * Empty the buffers.
+  *
+  * Must be called when a new file is opened, before it is passed to 
+  * MD_SN76489_VGM::start().
+  */
+  void reset(void);
+
+ /**
+  * Get the number of stalls.
+  *
+  * \return the number of times the player used up a buffer before the 
+  * next one was filled during idle(), since reset().
+  */
+  inline uint16_t getStalls(void) { return(_stalls); }
+
+ /**
+  * Get the next block of data.
+  *
+  * Hands the filled buffer to the player. If it is not filled yet it is
+  * read now.
+  *
+  * \param data  set to point to the first byte of the block.
+  * \return the number of bytes in the block, 0 at the end of the data.
+  */
+  size_t read(const uint8_t* &data);
+
+ /**
+  * Fill the buffer not being played.
+  */
+  void idle(void);
+
+ /**
+  * Move to a new position in the file.
+  *
+  * Empties the buffers and moves the file to the start of the block that
+  * holds the offset using seekBlock(), so reads stay block aligned.
+  *
+  * \param offset  the offset from the start of the file.
+  * \return true if seekBlock() moved the file.
+  */
+  bool seek(uint32_t offset);
+
+protected:
+ /**
+  * Read the next block of the file.
+  *
+  * Read the next len bytes of the file into the buffer. Each call reads the 
+  * block following the previous call, starting from the start of the file.
+  *
+  * \param buf   the buffer for the data.
+  * \param len   the number of bytes to read, BLOCK_SIZE.
+  * \return the number of bytes read, less than len at the end of the file.
+  */
+  virtual size_t readBlock(uint8_t* buf, size_t len) = 0;
+
+ /**
+  * Move the file to a new block.
+  *
+  * The next readBlock() reads the block starting at pos. Implement this
+  * to allow the player to go back to loop points and seek. The base class 
+  * method returns false.
+  *
+  * \param pos   the offset from the start of the file, a multiple of BLOCK_SIZE.
+  * \return true if the file was moved.
+  */
+  virtual bool seekBlock(uint32_t pos) { (void)pos; return(false); }
+
+private:
+  uint8_t _buf[2][BLOCK_SIZE];  ///< the two data buffers
+  uint16_t _len[2];   ///< number of bytes in each buffer
+  bool _full[2];      ///< true if the buffer has been filled and not yet played
+  uint8_t _next;      ///< the buffer to hand to the player next
+  bool _eof;          ///< true once the end of the file is read
+  bool _first;        ///< true until the first block is handed over
+  uint16_t _stalls;   ///< count of buffers read in read()
+  uint16_t _skip;     ///< bytes to skip at the start of the next block after seek()
+
+  void fill(uint8_t b);   ///< read the next block into buffer b
+};
+
+/**
+ * VGM data source that decompresses gzip (.vgz) data
+ *
+ * Reads the compressed data from another VGM data source and inflates it a
+ * block at a time into a circular history window. The blocks handed to the 
+ * player are in the window, so the data is not copied again. Data that 
+ * does not start with the gzip header is passed through unchanged.
+ */
+class MD_SN76489_VGZSource: public MD_SN76489_VGMSource
+{
+public:
+  static const uint16_t WINDOW_SIZE = SN_VGZ_WINDOW; ///< bytes of decompressed history kept
+
+ /**
+  * Class Constructor.
+  *
+  * \param src   the source of the compressed data.
+  */
+  MD_SN76489_VGZSource(MD_SN76489_VGMSource& src) : _src(src) { reset(); };
+
+ /**
+  * Start again.
+  *
+  * Must be called when a new file is opened, before it is passed to 
+  * MD_SN76489_VGM::start(). The source of the compressed data must
+  * also be reset to the start of the file.
+  */
+  void reset(void);
+
+ /**
+  * Get the next block of data.
+  *
+  * Hands the next block of decompressed data to the player. If it has
+  * not been decompressed yet it is decompressed now.
+  *
+  * \param data  set to point to the first byte of the block.
+  * \return the number of bytes in the block, 0 at the end of the data or on an error.
+  */
+  size_t read(const uint8_t* &data);
+
+ /**
+  * Decompress the next block ahead of the player.
+  */
+  void idle(void);
+
+ /**
+  * Check if the data is in program memory.
+  *
+  * \return true if uncompressed data is being passed through from program memory.
+  */
+  bool isProgmem(void) { return(_state == ST_RAW && _src.isProgmem()); }
+
+ /**
+  * Move to a new position in the decompressed data.
+  *
+  * A position still held in the window is played again from the window.
+  * A position further back needs the source to seek() to the start, and
+  * all the data up to the position is decompressed again. A position 
+  * ahead is found by decompressing the data up to it.
+  *
+  * \param offset  the offset from the start of the decompressed data.
+  * \return true if the position was found.
+  */
+  bool seek(uint32_t offset);
+
+ /**
+  * Check if the data is compressed.
+  *
+  * Only valid after the first block has been read.
+  *
+  * \return true if the data is gzip compressed.
+  */
+  inline bool isCompressed(void) { return(_state != ST_RAW); }
+
+ /**
+  * Check for an error in the compressed data.
+  *
+  * \return true if the data is not valid or needs a window larger than SN_VGZ_WINDOW.
+  */
+  inline bool isError(void) { return(_state == ST_ERROR); }
+
+private:
+  static const uint16_t BLOCK_SIZE = SN_VGM_BLOCK;   ///< bytes decompressed at a time
+  static const uint16_t WINDOW_MASK = WINDOW_SIZE - 1; ///< wrap positions in the window
+
+  static_assert((WINDOW_SIZE & WINDOW_MASK) == 0, "SN_VGZ_WINDOW must be a power of 2");
+  static_assert(WINDOW_SIZE >= 2 * BLOCK_SIZE, "SN_VGZ_WINDOW must be at least 2 SN_VGM_BLOCK");
+
+  enum state_t 
+  { 
+    ST_START,   ///< first block, look for the gzip header
+    ST_RAW,     ///< data not compressed, passed through
+    ST_BLOCK,   ///< next deflate block header
+    ST_STORED,  ///< copying a stored block
+    ST_HUFFMAN, ///< decoding a compressed block
+    ST_END,     ///< all the data has been decompressed
+    ST_ERROR,   ///< error in the data
+  };
+
+  MD_SN76489_VGMSource& _src; ///< the source of the compressed data
+  const uint8_t* _in;         ///< next byte of compressed data
+  const uint8_t* _inEnd;      ///< end of the current compressed block
+  bool _inPgm;                ///< true if the compressed data is in program memory
+  bool _inEof;                ///< true when there is no more compressed data
+  uint32_t _bitBuf;           ///< bits read but not yet used
+  uint8_t _bitCount;          ///< number of bits in _bitBuf
+
+  state_t _state;     ///< decoder state
+  bool _lastBlock;    ///< true in the final deflate block
+  uint16_t _stored;   ///< bytes left to copy in a stored block
+  uint16_t _copyLen;  ///< bytes left to copy from earlier in the window
+  uint16_t _copyDist; ///< distance back to copy from
+  uint32_t _outTotal; ///< bytes of decompressed data so far
+
+  uint8_t _win[WINDOW_SIZE];  ///< decompressed data history
+  uint16_t _wPos;     ///< next position to write in the window
+  uint16_t _aheadPos; ///< start of the block decompressed ahead
+  uint16_t _aheadLen; ///< length of the block decompressed ahead, 0 if none
+  uint16_t _replayPos;  ///< next position to play again from the window after seek()
+  uint16_t _replayLen;  ///< bytes left to play again from the window
+
+  // canonical Huffman code tables, number of codes of each length and the symbols in code order
+  uint16_t _litCount[16];   ///< literal/length code counts
+  uint16_t _litSym[288];    ///< literal/length symbols
+  uint16_t _distCount[16];  ///< distance code counts
+  uint16_t _distSym[32];    ///< distance symbols
+
+  uint8_t getByte(void);          ///< next byte of compressed data
+  uint16_t getBits(uint8_t n);    ///< next n bits of compressed data
+  int16_t decodeSym(const uint16_t* count, const uint16_t* sym); ///< decode one Huffman coded symbol
+  bool buildTable(uint16_t* count, uint16_t* sym, const uint8_t* len, uint16_t n); ///< build a table from the code lengths
+  void begin(void);               ///< check the first block for compressed data
+  bool readHeader(void);          ///< check and skip the gzip header
+  bool readTables(void);          ///< read the code tables for a dynamic block
+  void fixedTables(void);         ///< set up the tables for a fixed block
+  uint16_t inflate(uint16_t len); ///< decompress up to len bytes into the window
+  uint16_t decompress(void);      ///< decompress the next block into the window
+};
+
+/**
+ * Class to play VGM file data to a SN76489 IC
+ */
+class MD_SN76489_VGM
+{
+public:
+  static const uint16_t SAMPLE_RATE = 44100;  ///< VGM wait commands are in samples at this rate
+  static const uint16_t LOOP_FOREVER = 0xffff; ///< setLoops() value to repeat the loop until stopped
+
+ /**
+  * Seek index checkpoint.
+  *
+  * The player state at a point in the file. The player can start again 
+  * from any checkpoint by moving the source to the offset and writing the
+  * registers to the IC.
+  */
+  typedef struct
+  {
+    uint32_t sample;        ///< position in samples from the start of the data
+    uint32_t offset;        ///< offset of the next command in the file
+    MD_SN76489_Regs regs;   ///< IC registers at the position
+  } checkpoint_t;
+
+ /**
+  * Class Constructor.
+  *
+  * Instantiate a new instance of the class.
+  *
+  * \param S   the MD_SN76489 object the music is played on.
+  */
+  MD_SN76489_VGM(MD_SN76489& S) : _S(S), _src(nullptr), _playing(false), 
+    _dataOffset(0), _loops(LOOP_FOREVER), _index(nullptr), _indexSize(0), _indexCount(0), 
+    _interval(0) {};
+
+ /**
+  * Start playing VGM data.
+  *
+  * Reads and checks the VGM or compact stream file header from the source 
+  * and gets ready to play the data, which starts on the next call to poll().
+  *
+  * \param src   the source of the VGM file data, positioned at the start of the file.
+  * \return true if the header is valid and the data can be played.
+  */
+  bool start(MD_SN76489_VGMSource& src);
+
+ /**
+  * Stop playing.
+  *
+  * Stops playing the VGM data and turns off all the IC channels.
+  */
+  void stop(void);
+
+ /**
+  * Play the VGM data.
+  *
+  * Sends all the register writes that are now due to the IC. This must be
+  * called often (eg, every time through loop()), but it does not matter if
+  * some calls are late. Uses micros() as the time.
+  *
+  * \return true if the data is still playing, false at the end of the data.
+  */
+  inline bool poll(void) { return(poll(micros())); }
+
+ /**
+  * Play the VGM data against an application time source.
+  *
+  * As for poll(void), with the current time supplied by the application.
+  *
+  * \param now   the current time in microseconds.
+  * \return true if the data is still playing, false at the end of the data.
+  */
+  bool poll(uint32_t now);
+
+ /**
+  * Check if the VGM data is playing.
+  *
+  * \return true if the data is playing, false if stopped or at the end.
+  */
+  inline bool isPlaying(void) { return(_playing); }
+
+ /**
+  * Get the VGM file version.
+  *
+  * \return the version in BCD (eg, 0x150 for version 1.50), or 1 for a compact stream file.
+  */
+  inline uint32_t getVersion(void) { return(_version); }
+
+ /**
+  * Get the SN76489 clock in the VGM file.
+  *
+  * The music plays at the right pitch if this is the clock supplied to the
+  * IC (for MD_SN76489_Emu, use begin(clockHz) with this value).
+  *
+  * \return the IC clock frequency in Hz.
+  */
+  inline uint32_t getClock(void) { return(_clockHz); }
+
+ /**
+  * Get the total length of the VGM data.
+  *
+  * \return the total number of samples in the file.
+  */
+  inline uint32_t getTotalSamples(void) { return(_totalSamples); }
+
+ /**
+  * Get the current play position.
+  *
+  * The position goes back to the loop point each time the data loops.
+  *
+  * \return the position of the next command, in samples from the start of the data.
+  */
+  inline uint32_t getSamplePos(void) { return(_samplePos); }
+
+ /**
+  * Set the number of times to loop.
+  *
+  * At the end of the data, play continues from the loop point in the file
+  * header this many more times. Files without a loop point end the first 
+  * time. Takes effect at the next start().
+  *
+  * \param count the number of times to repeat the loop, 0 for none or LOOP_FOREVER (default).
+  */
+  inline void setLoops(uint16_t count) { _loops = count; }
+
+ /**
+  * Get the length of the loop.
+  *
+  * \return the number of samples in the loop, 0 if the file does not loop.
+  */
+  inline uint32_t getLoopSamples(void) { return(_loopOffset != 0 ? _loopSamples : 0); }
+
+ /**
+  * Set the buffer for the seek index.
+  *
+  * While the file is played (or passed over by seek()) for the first 
+  * time, a checkpoint is saved in the index every interval samples. If 
+  * the index fills up, every other checkpoint is dropped and the interval 
+  * doubled, so the index always covers the whole of the file played so far.
+  * The index is emptied by start().
+  *
+  * \param index     the array for the checkpoints, or nullptr for no index.
+  * \param size      the number of checkpoints in the array.
+  * \param interval  the samples between checkpoints (default 5 seconds).
+  */
+  void setIndex(checkpoint_t* index, uint16_t size, uint32_t interval = 5UL * SAMPLE_RATE);
+
+ /**
+  * Get the number of checkpoints in the seek index.
+  *
+  * \return the number of checkpoints saved since start().
+  */
+  inline uint16_t getIndexCount(void) { return(_indexCount); }
+
+ /**
+  * Move the play position.
+  *
+  * Starts again from the nearest checkpoint in the index before the 
+  * position, or the start of the data, and passes over the commands from 
+  * there to the position without sending them to the IC or waiting. The 
+  * IC registers are then set as they would be at the position and play 
+  * continues from there on the next poll(). A position ahead of the current 
+  * position and the checkpoints carries on from the current position.
+  *
+  * The source must support seek(), except when moving ahead from the 
+  * current position.
+  *
+  * \param sample  the new position in samples from the start of the data.
+  * \return true if the position was found and the data is playing.
+  */
+  bool seek(uint32_t sample);
+
+private:
+  // VGM header offsets
+  static const uint8_t HDR_IDENT = 0x00;      ///< file identification " mgV"
+  static const uint8_t HDR_VERSION = 0x08;    ///< version number
+  static const uint8_t HDR_SN_CLOCK = 0x0c;   ///< SN76489 clock
+  static const uint8_t HDR_SAMPLES = 0x18;    ///< total number of samples
+  static const uint8_t HDR_LOOP = 0x1c;       ///< relative offset to the loop point
+  static const uint8_t HDR_LOOP_SAMPLES = 0x20; ///< number of samples in the loop
+  static const uint8_t HDR_DATA = 0x34;       ///< relative offset to the VGM data (version 1.50+)
+  static const uint8_t HDR_SIZE = 0x40;       ///< header bytes read by start()
+
+  static const uint32_t VGM_IDENT = 0x206d6756; ///< " mgV" read as little endian
+
+  // Compact stream format
+  static const uint32_t SNS_IDENT = 0x01534e53; ///< "SNS" and format version 1, read as little endian
+  static const uint8_t SNS_HDR_SIZE = 24;     ///< header size for format version 1
+  static const uint8_t SNS_END = 0x00;        ///< end of data
+  static const uint8_t SNS_WAIT_FRAMES = 0x01;///< 0x01-0x0f wait 1-15 frames
+  static const uint8_t SNS_WAIT = 0x10;       ///< wait for a variable length number of samples, 0x11-0x1f wait 1-15 samples
+  static const uint8_t SNS_REPEAT = 0x20;     ///< play an earlier section again
+  static const uint8_t SNS_DATA = 0x40;       ///< 0x40-0x7f data byte
+  static const uint8_t SNS_LATCH = 0x80;      ///< 0x80-0xff latch byte
+  static const uint32_t US_PER_SAMPLE = ((1000000ULL << 24) + SAMPLE_RATE / 2) / SAMPLE_RATE; ///< 1e6/SAMPLE_RATE in 8.24 fixed point
+
+  MD_SN76489& _S;               ///< the IC the music is played on
+  MD_SN76489_VGMSource* _src;   ///< the source of the VGM data
+  const uint8_t* _p;            ///< next byte in the current block
+  const uint8_t* _end;          ///< end of the current block
+
+  bool _playing;          ///< true if the data is playing
+  bool _timeSet;          ///< true once the start time is set by poll()
+  uint32_t _dueUs;        ///< time the next command is due, in micros()
+  uint32_t _dueFrac;      ///< fraction of a microsecond to add to _dueUs, 0.24 fixed point
+  uint32_t _samplePos;    ///< samples played since the start of the data
+
+  uint32_t _version;      ///< VGM file version
+  uint32_t _clockHz;      ///< SN76489 clock in the file header
+  uint32_t _totalSamples; ///< total samples in the file
+  uint32_t _dataOffset;   ///< offset of the first command in the file
+  uint32_t _loopOffset;   ///< offset of the loop point in the file, 0 if none
+  uint32_t _loopSamples;  ///< samples in the loop
+
+  uint16_t _loops;        ///< times to loop for each start()
+  uint16_t _loopsLeft;    ///< times left to loop
+  bool _looped;           ///< true once the player has gone back to the loop point
+  uint32_t _endPos;       ///< file offset of the end of the current block
+  uint32_t _seekOver;     ///< samples from the seek() position to the next command
+
+  checkpoint_t* _index;   ///< seek index
+  uint16_t _indexSize;    ///< number of checkpoints in _index
+  uint16_t _indexCount;   ///< number of checkpoints saved
+  uint32_t _interval;     ///< samples between checkpoints set by setIndex()
+  uint32_t _indexStep;    ///< samples between checkpoints now
+
+  bool _sns;              ///< true for the compact stream format
+  uint16_t _frame;        ///< samples in a frame for the compact stream format
+  uint32_t _callRet;      ///< offset to carry on from after a repeated section
+  uint32_t _callEnd;      ///< offset of the end of the repeated section being played, 0 if none
+
+  bool _skipping;         ///< true while seek() is passing over commands
+  MD_SN76489_Regs _regs;  ///< registers while seek() is passing over commands
+
+  uint8_t _wBuf[16];      ///< register writes waiting to be sent
+  uint8_t _wCount;        ///< number of bytes in _wBuf
+
+  bool _pgm;              ///< true if the current block is in program memory
+
+  inline int16_t next(void) { if (_p == _end && !fill()) return(-1); return(_pgm ? pgm_read_byte(_p++) : *_p++); } ///< next byte of data or -1 at the end
+  inline uint32_t filePos(void) { return(_endPos - (_end - _p)); } ///< file offset of the next byte
+  bool fill(void);                ///< get the next block from the source
+  bool jump(uint32_t offset);     ///< move the source to the offset
+  void skip(uint32_t n);          ///< skip n bytes of data
+  uint32_t readLE(uint8_t size);  ///< read a little endian number of size bytes
+  uint32_t readVar(void);         ///< read a variable length number
+  uint32_t command(void);         ///< process the next command, returns the samples to wait
+  uint32_t commandSNS(void);      ///< process the next compact stream command
+  void put(uint8_t data);         ///< register write from the data
+  void end(void);                 ///< end of the data, loop or stop
+  void wait(uint32_t samples);    ///< advance the due time
+  void flush(void);               ///< send the buffered register writes
+  void checkpoint(void);          ///< save a checkpoint in the index if one is due
+  void restore(const MD_SN76489_Regs& regs);  ///< write the registers to the IC
+};
+
+/**
+ * Base class for the destination of recorded VGM file data
+ *
+ * MD_SN76489_VGMRecorder writes the VGM file through this class, so the 
+ * recording can go to an SD card file, memory, a serial port or anywhere
+ * else the application can write it to. Derived classes implement write()
+ * for the storage used.
+ */
+class MD_SN76489_VGMSink
+{
+public:
+ /**
+  * Write a block of data.
+  *
+  * Called for each command recorded and for the file header.
+  *
+  * \param data  pointer to the bytes to write.
+  * \param len   the number of bytes to write.
+  * \return the number of bytes written, less than len if the sink is full.
+  */
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+
+ /**
+  * Move to a new position in the data.
+  *
+  * The next write() writes the data starting at the offset. Used by the
+  * recorder to fill in the header once the recording is stopped. The base 
+  * class method returns false.
+  *
+  * \param offset  the offset from the start of the file.
+  * \return true if the sink has moved to the offset.
+  */
+  virtual bool seek(uint32_t offset) { (void)offset; return(false); }
+
+ /**
+  * Class Destructor.
+  */
+  virtual ~MD_SN76489_VGMSink(void) {};
+};
+
+/**
+ * VGM data sink for a file held in memory
+ *
+ * The VGM file is recorded into a buffer supplied by the application. The
+ * recording can then be played again from the buffer with 
+ * MD_SN76489_VGMMemory, or compared with a known good recording.
+ */
+class MD_SN76489_VGMBuffer: public MD_SN76489_VGMSink
+{
+public:
+ /**
+  * Class Constructor.
+  *
+  * \param buf   pointer to the buffer for the file data.
+  * \param size  the size of the buffer in bytes.
+  */
+  MD_SN76489_VGMBuffer(uint8_t* buf, uint32_t size) :
+    _buf(buf), _size(size), _pos(0), _len(0) {};
+
+ /**
+  * Empty the buffer for a new recording.
+  */
+  inline void reset(void) { _pos = _len = 0; }
+
+ /**
+  * Get the length of the recorded data.
+  *
+  * \return the number of bytes of file data in the buffer.
+  */
+  inline uint32_t getLength(void) { return(_len); }
+
+ /**
+  * Get the recorded data.
+  *
+  * \return pointer to the start of the buffer.
+  */
+  inline const uint8_t* getData(void) { return(_buf); }
+
+  size_t write(const uint8_t* data, size_t len);  ///< implements MD_SN76489_VGMSink::write()
+  bool seek(uint32_t offset);                      ///< implements MD_SN76489_VGMSink::seek()
+
+private:
+  uint8_t* _buf;      ///< the file data
+  uint32_t _size;     ///< the size of the buffer
+  uint32_t _pos;      ///< offset of the next byte written
+  uint32_t _len;      ///< the length of the data written
+};
+
+/**
+ * Class to record the writes made to a SN76489 IC as a VGM file
+ *
+ * The recorder is a MD_SN76489 object that wraps another MD_SN76489 
+ * object. Every byte sent to the recorder is passed on to the wrapped 
+ * object and, while recording, is also written to the sink as a VGM 1.50
+ * file made of 0x50 write and 0x61 wait commands.
+ *
+ * \sa \ref pageVGM
+ */
+class MD_SN76489_VGMRecorder: public MD_SN76489
+{
+public:
+  static const uint16_t SAMPLE_RATE = MD_SN76489_VGM::SAMPLE_RATE; ///< VGM wait commands are in samples at this rate
+  static const uint8_t HDR_SIZE = 0x40;  ///< size of the VGM header written
+
+ /**
+  * Class Constructor.
+  *
+  * The wrapped object does the hardware data transfer and its clock is 
+  * used for the recording. It must not be written to directly while 
+  * recording, as those writes are not recorded.
+  *
+  * \param dev   the MD_SN76489 object to pass the writes to.
+  * \param sink  the destination for the VGM file data.
+  */
+  MD_SN76489_VGMRecorder(MD_SN76489& dev, MD_SN76489_VGMSink& sink) :
+    MD_SN76489(false), _dev(dev), _sink(sink), _recording(false), _timeSet(false) {};
+
+ /**
+  * Initialize the object.
+  *
+  * Initializes the wrapped object and then this object with the same IC
+  * clock frequency. Use this, or begin(uint32_t), in place of begin() for
+  * the wrapped object.
+  */
+  void begin(void);
+  using MD_SN76489::begin;   // begin(clockHz) from the base class
+
+ /**
+  * Start a recording.
+  *
+  * Writes the VGM header to the sink and the register values already known
+  * by the library, so the file starts from the same IC state. Time in the 
+  * recording is counted from this call.
+  *
+  * \return true if the recording has started.
+  */
+  bool start(void);
+
+ /**
+  * Stop a recording.
+  *
+  * Writes the wait up to the current time and the end of data command. If
+  * the sink can seek(), the header is then written again with the file
+  * length and the total samples. The header of a recording to a sink 
+  * that cannot seek has 0 for both.
+  *
+  * \return true if the recording is complete, including the header.
+  */
+  bool stop(void);
+
+ /**
+  * Check if a recording is running.
+  *
+  * A recording stops if the sink is full.
+  *
+  * \return true if the writes are being recorded.
+  */
+  inline bool isRecording(void) { return(_recording); }
+
+ /**
+  * Set the recording time.
+  *
+  * By default the time of each write is read from micros(). Once this 
+  * method is called the time given is used instead until the next call,
+  * so the recording follows a 'virtual clock' and is the same every time
+  * the same writes are made.
+  *
+  * \param us  the current time in microseconds.
+  */
+  inline void setTime(uint32_t us) { _timeSet = true; _timeNow = us; }
+
+ /**
+  * Get the length of the recording.
+  *
+  * \return the recording time so far, in samples at 44.1kHz.
+  */
+  inline uint32_t getSamples(void) { return(_samples + _wait); }
+
+ /**
+  * Get the number of writes recorded.
+  *
+  * \return the number of register writes in the recording, including those
+  * written by start() for the IC state.
+  */
+  inline uint32_t getWrites(void) { return(_writes); }
+
+ /**
+  * Get the length of the file.
+  *
+  * \return the number of bytes written to the sink since start().
+  */
+  inline uint32_t getLength(void) { return(_length); }
+
+protected:
+  void send(uint8_t data);                          ///< pass on and record a byte
+  void sendBurst(const uint8_t* data, size_t len);  ///< pass on and record a sequence of bytes
+
+private:
+  MD_SN76489& _dev;           ///< the wrapped object
+  MD_SN76489_VGMSink& _sink;  ///< destination for the file data
+  bool _recording;    ///< true while the writes are recorded
+  bool _timeSet;      ///< true when the time is set by setTime()
+  uint32_t _timeNow;  ///< the time set by setTime()
+  uint32_t _timeLast; ///< the time of the last write
+  uint16_t _timeRem;  ///< fraction of a sample carried to the next write, in 1/10000 samples
+  uint32_t _samples;  ///< samples in the wait commands written
+  uint32_t _wait;     ///< samples to wait before the next write
+  uint32_t _writes;   ///< the number of bytes recorded
+  uint32_t _length;   ///< the number of bytes written to the sink
+
+  uint32_t now(void);             ///< the current time in microseconds
+  void advance(void);             ///< add the time since the last write to the wait
+  void putWait(void);             ///< write the wait commands for the pending wait
+  void put(const uint8_t* data, uint8_t len); ///< write a command to the sink
+  void record(uint8_t data);      ///< record a byte sent to the IC
+  void header(void);              ///< write the VGM header
+};
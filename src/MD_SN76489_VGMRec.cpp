@@ -0,0 +1,221 @@
+/*
+MD_SN76489 - Library for using a SN74689 sound generator
+
+See header file for copyright and licensing comments.
+*/
+#include <MD_SN76489.h>
+
+/**
+ * \file
+ * \brief Class MD_SN76489_VGMRecorder and MD_SN76489_VGMBuffer functions
+ *
+ * The recording is a VGM 1.50 file with a 64 byte header, followed by
+ * 0x50 (SN76489 write) and 0x61 (wait n samples) commands and ending with
+ * the 0x66 end of data command.
+ */
+
+// VGM file constants
+static const uint32_t VGM_IDENT = 0x206d6756;   // "Vgm "
+static const uint16_t VGM_VERSION = 0x0150;
+static const uint16_t VGM_FEEDBACK = 0x0003;    // SN76489AN white noise taps
+static const uint8_t VGM_SHIFT_WIDTH = 15;      // SN76489AN noise shift register width
+
+static const uint8_t VGM_WRITE = 0x50;
+static const uint8_t VGM_WAIT = 0x61;
+static const uint8_t VGM_END = 0x66;
+
+static void setLE(uint8_t* p, uint32_t v, uint8_t size)
+// store a little endian number of size bytes
+{
+  for (uint8_t i = 0; i < size; i++)
+  {
+    p[i] = v & 0xff;
+    v >>= 8;
+  }
+}
+
+//--------------------------------------------------------------
+size_t MD_SN76489_VGMBuffer::write(const uint8_t* data, size_t len)
+{
+  if (len > _size - _pos)
+    len = _size - _pos;
+
+  memcpy(_buf + _pos, data, len);
+  _pos += len;
+  if (_pos > _len) _len = _pos;
+
+  return(len);
+}
+
+bool MD_SN76489_VGMBuffer::seek(uint32_t offset)
+{
+  if (offset > _len)
+    return(false);
+
+  _pos = offset;
+
+  return(true);
+}
+
+//--------------------------------------------------------------
+void MD_SN76489_VGMRecorder::begin(void)
+{
+  _recording = false;
+  _dev.begin(_clockHz);
+  MD_SN76489::begin();
+}
+
+bool MD_SN76489_VGMRecorder::start(void)
+{
+  const MD_SN76489_Regs& regs = getRegs();
+  uint8_t latched = regs.getLatched();
+
+  SN_LOCK();
+  _timeLast = now();
+  _timeRem = 0;
+  _samples = _wait = 0;
+  _writes = 0;
+  _length = 0;
+  _recording = true;
+
+  header();
+
+  // the IC state at the start, with the latched register written last
+  for (uint8_t i = 1; i <= MD_SN76489_Regs::REG_COUNT && _recording; i++)
+  {
+    uint8_t reg = (latched + i) % MD_SN76489_Regs::REG_COUNT;
+
+    if (regs.isKnown(reg))
+    {
+      uint16_t v = regs.get(reg);
+
+      record(0x80 | (reg << 4) | (v & 0xf));
+      if (MD_SN76489_Regs::isTone(reg))
+        record((v >> 4) & 0x3f);
+    }
+  }
+  SN_UNLOCK();
+
+  return(_recording);
+}
+
+bool MD_SN76489_VGMRecorder::stop(void)
+{
+  bool b = false;
+
+  SN_LOCK();
+  if (_recording)
+  {
+    const uint8_t cmd = VGM_END;
+
+    advance();
+    putWait();
+    put(&cmd, 1);
+
+    // fill in the header
+    if (_recording && _sink.seek(0))
+    {
+      uint32_t len = _length;
+
+      header();
+      _length = len;
+      b = _recording && _sink.seek(_length);
+    }
+    _recording = false;
+  }
+  SN_UNLOCK();
+
+  return(b);
+}
+
+uint32_t MD_SN76489_VGMRecorder::now(void)
+{
+  return(_timeSet ? _timeNow : micros());
+}
+
+void MD_SN76489_VGMRecorder::advance(void)
+// Add the time since the last write to the wait. 441/10000 samples per
+// microsecond is exactly 44.1kHz, and the fraction of a sample is carried
+// so the recording stays locked to the time source.
+{
+  uint32_t t = now();
+  uint32_t dt = t - _timeLast;
+
+  _timeLast = t;
+  while (dt != 0)
+  {
+    uint32_t step = (dt > 1000000UL) ? 1000000UL : dt;  // step * 441 fits in 32 bits
+    uint32_t x = (step * 441) + _timeRem;
+
+    _wait += x / 10000;
+    _timeRem = x % 10000;
+    dt -= step;
+  }
+}
+
+void MD_SN76489_VGMRecorder::putWait(void)
+{
+  while (_wait != 0 && _recording)
+  {
+    uint16_t n = (_wait > 0xffff) ? 0xffff : _wait;
+    uint8_t cmd[3] = { VGM_WAIT, (uint8_t)(n & 0xff), (uint8_t)(n >> 8) };
+
+    put(cmd, sizeof(cmd));
+    _samples += n;
+    _wait -= n;
+  }
+}
+
+void MD_SN76489_VGMRecorder::put(const uint8_t* data, uint8_t len)
+// the recording stops if the sink is full
+{
+  size_t n = _sink.write(data, len);
+
+  _length += n;
+  if (n != len)
+    _recording = false;
+}
+
+void MD_SN76489_VGMRecorder::record(uint8_t data)
+{
+  uint8_t cmd[2] = { VGM_WRITE, data };
+
+  if (!_recording)
+    return;
+
+  advance();
+  putWait();
+  put(cmd, sizeof(cmd));
+  _writes++;
+}
+
+void MD_SN76489_VGMRecorder::header(void)
+{
+  uint8_t h[HDR_SIZE];
+
+  memset(h, 0, sizeof(h));
+  setLE(&h[0x00], VGM_IDENT, 4);
+  if (_length != 0) setLE(&h[0x04], _length - 4, 4);   // EOF offset, once known
+  setLE(&h[0x08], VGM_VERSION, 4);
+  setLE(&h[0x0c], _clockHz, 4);
+  setLE(&h[0x18], _samples, 4);
+  setLE(&h[0x28], VGM_FEEDBACK, 2);
+  h[0x2a] = VGM_SHIFT_WIDTH;
+  setLE(&h[0x34], HDR_SIZE - 0x34, 4);  // data offset, relative to 0x34
+
+  _length = 0;
+  put(h, sizeof(h));
+}
+
+void MD_SN76489_VGMRecorder::send(uint8_t data)
+{
+  _dev.write(data);
+  record(data);
+}
+
+void MD_SN76489_VGMRecorder::sendBurst(const uint8_t* data, size_t len)
+{
+  _dev.write(data, len);
+  for (size_t i = 0; i < len; i++)
+    record(data[i]);
+}
@@ -0,0 +1,459 @@
+/*
+MD_SN76489 - Library for using a SN74689 sound generator
+
+See header file for copyright and licensing comments.
+*/
+#include <MD_SN76489.h>
+
+/**
+ * \file
+ * \brief Class MD_SN76489_VGZSource functions
+ *
+ * The inflate decoder follows RFC 1951 (deflate) and RFC 1952 (gzip).
+ * Huffman codes are decoded a bit at a time from canonical code tables,
+ * which keeps the tables small enough for small MCUs.
+ */
+
+// Base values and extra bits for the length and distance codes
+static const uint16_t PROGMEM lenBase[29] =
+{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t PROGMEM lenExtra[29] =
+{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t PROGMEM distBase[30] =
+{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t PROGMEM distExtra[30] =
+{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Order of the code length code lengths in a dynamic block header
+static const uint8_t PROGMEM clOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+void MD_SN76489_VGZSource::reset(void)
+{
+  _in = _inEnd = nullptr;
+  _inPgm = _inEof = false;
+  _bitBuf = 0;
+  _bitCount = 0;
+  _state = ST_START;
+  _lastBlock = false;
+  _stored = _copyLen = _copyDist = 0;
+  _outTotal = 0;
+  _wPos = _aheadPos = _aheadLen = 0;
+  _replayPos = _replayLen = 0;
+}
+
+uint8_t MD_SN76489_VGZSource::getByte(void)
+{
+  if (_in == _inEnd)
+  {
+    size_t len = _src.read(_in);
+
+    _inEnd = _in + len;
+    if (len == 0)
+    {
+      _inEof = true;
+      return(0);
+    }
+  }
+
+  return(_inPgm ? pgm_read_byte(_in++) : *_in++);
+}
+
+uint16_t MD_SN76489_VGZSource::getBits(uint8_t n)
+// Deflate packs the bits from the LSB of each byte
+{
+  uint16_t v;
+
+  while (_bitCount < n)
+  {
+    _bitBuf |= (uint32_t)getByte() << _bitCount;
+    _bitCount += 8;
+  }
+
+  v = _bitBuf & ((1UL << n) - 1);
+  _bitBuf >>= n;
+  _bitCount -= n;
+
+  return(v);
+}
+
+int16_t MD_SN76489_VGZSource::decodeSym(const uint16_t* count, const uint16_t* sym)
+// Codes of each length are consecutive numbers starting at first, so
+// add a bit at a time until the code is in the range for its length.
+{
+  uint16_t code = 0, first = 0, index = 0;
+
+  for (uint8_t len = 1; len < 16; len++)
+  {
+    if (_bitCount == 0)
+    {
+      _bitBuf = getByte();
+      _bitCount = 8;
+    }
+    code |= _bitBuf & 1;
+    _bitBuf >>= 1;
+    _bitCount--;
+
+    if (code < first + count[len])
+      return(sym[index + code - first]);
+
+    index += count[len];
+    first = (first + count[len]) << 1;
+    code <<= 1;
+  }
+
+  return(-1);   // not a valid code
+}
+
+bool MD_SN76489_VGZSource::buildTable(uint16_t* count, uint16_t* sym, const uint8_t* len, uint16_t n)
+{
+  uint16_t offset[16];
+  int16_t left = 1;
+
+  memset(count, 0, sizeof(offset));   // same size as count
+  for (uint16_t i = 0; i < n; i++)
+    count[len[i]]++;
+
+  // check the code is not over subscribed, an incomplete code is allowed
+  for (uint8_t l = 1; l < 16; l++)
+  {
+    left = (left << 1) - count[l];
+    if (left < 0)
+      return(false);
+  }
+
+  // sort the symbols by code length
+  offset[1] = 0;
+  for (uint8_t l = 1; l < 15; l++)
+    offset[l + 1] = offset[l] + count[l];
+  for (uint16_t i = 0; i < n; i++)
+    if (len[i] != 0)
+      sym[offset[len[i]]++] = i;
+
+  return(true);
+}
+
+bool MD_SN76489_VGZSource::readHeader(void)
+{
+  const uint8_t FHCRC = 0x02, FEXTRA = 0x04, FNAME = 0x08, FCOMMENT = 0x10;
+  uint8_t flags;
+
+  // ID1, ID2 and CM (8 = deflate)
+  if (getByte() != 0x1f || getByte() != 0x8b || getByte() != 8)
+    return(false);
+  flags = getByte();
+  for (uint8_t i = 0; i < 6; i++)   // MTIME, XFL, OS
+    getByte();
+
+  if (flags & FEXTRA)
+  {
+    uint16_t n = getByte();
+
+    n |= getByte() << 8;
+    while (n-- > 0 && !_inEof)
+      getByte();
+  }
+  if (flags & FNAME)
+    while (getByte() != 0 && !_inEof)
+      ;
+  if (flags & FCOMMENT)
+    while (getByte() != 0 && !_inEof)
+      ;
+  if (flags & FHCRC)
+  {
+    getByte();
+    getByte();
+  }
+
+  return(!_inEof);
+}
+
+void MD_SN76489_VGZSource::fixedTables(void)
+{
+  uint8_t len[288];
+  uint16_t i;
+
+  for (i = 0; i < 144; i++) len[i] = 8;
+  for (; i < 256; i++) len[i] = 9;
+  for (; i < 280; i++) len[i] = 7;
+  for (; i < 288; i++) len[i] = 8;
+  buildTable(_litCount, _litSym, len, 288);
+
+  for (i = 0; i < 30; i++) len[i] = 5;
+  buildTable(_distCount, _distSym, len, 30);
+}
+
+bool MD_SN76489_VGZSource::readTables(void)
+{
+  uint8_t len[286 + 30];
+  uint16_t nLit = getBits(5) + 257;
+  uint16_t nDist = getBits(5) + 1;
+  uint8_t nCode = getBits(4) + 4;
+  uint16_t i;
+
+  if (nLit > 286 || nDist > 30)
+    return(false);
+
+  // code length code, held in the distance table until it is needed
+  memset(len, 0, 19);
+  for (i = 0; i < nCode; i++)
+    len[pgm_read_byte(&clOrder[i])] = getBits(3);
+  if (!buildTable(_distCount, _distSym, len, 19))
+    return(false);
+
+  // literal/length and distance code lengths
+  i = 0;
+  while (i < nLit + nDist)
+  {
+    int16_t sym = decodeSym(_distCount, _distSym);
+    uint8_t l = 0, rep;
+
+    if (sym < 0 || _inEof)
+      return(false);
+    if (sym < 16)
+    {
+      len[i++] = sym;
+      continue;
+    }
+
+    if (sym == 16)        // repeat the last length 3-6 times
+    {
+      if (i == 0) return(false);
+      l = len[i - 1];
+      rep = 3 + getBits(2);
+    }
+    else if (sym == 17)   // 3-10 zeros
+      rep = 3 + getBits(3);
+    else                  // 11-138 zeros
+      rep = 11 + getBits(7);
+
+    if (i + rep > nLit + nDist)
+      return(false);
+    while (rep-- > 0)
+      len[i++] = l;
+  }
+
+  if (len[256] == 0)    // no end of block code
+    return(false);
+
+  return(buildTable(_litCount, _litSym, len, nLit) && buildTable(_distCount, _distSym, len + nLit, nDist));
+}
+
+uint16_t MD_SN76489_VGZSource::inflate(uint16_t len)
+{
+  uint16_t n = 0;
+
+  while (n < len && _state >= ST_BLOCK && _state <= ST_HUFFMAN)
+  {
+    switch (_state)
+    {
+    case ST_BLOCK:
+      if (_lastBlock)
+      {
+        _state = ST_END;
+        break;
+      }
+      _lastBlock = getBits(1);
+      switch (getBits(2))
+      {
+      case 0:   // stored, starts on the next byte boundary
+        _bitBuf = 0;
+        _bitCount = 0;
+        _stored = getBits(16);
+        _state = ((uint16_t)~getBits(16) == _stored) ? ST_STORED : ST_ERROR;
+        break;
+
+      case 1:   // fixed Huffman codes
+        fixedTables();
+        _state = ST_HUFFMAN;
+        break;
+
+      case 2:   // dynamic Huffman codes
+        _state = readTables() ? ST_HUFFMAN : ST_ERROR;
+        break;
+
+      default:
+        _state = ST_ERROR;
+        break;
+      }
+      break;
+
+    case ST_STORED:
+      while (_stored > 0 && n < len)
+      {
+        _win[_wPos++] = getByte();
+        _stored--;
+        n++;
+      }
+      if (_stored == 0)
+        _state = ST_BLOCK;
+      break;
+
+    case ST_HUFFMAN:
+      if (_copyLen > 0)   // copy the match, which may be cut short by the end of the block
+      {
+        while (_copyLen > 0 && n < len)
+        {
+          _win[_wPos] = _win[(uint16_t)(_wPos - _copyDist) & WINDOW_MASK];
+          _wPos++;
+          _copyLen--;
+          n++;
+        }
+      }
+      else
+      {
+        int16_t sym = decodeSym(_litCount, _litSym);
+
+        if (sym < 0)
+          _state = ST_ERROR;
+        else if (sym < 256)   // literal
+        {
+          _win[_wPos++] = sym;
+          n++;
+        }
+        else if (sym == 256)  // end of block
+          _state = ST_BLOCK;
+        else if (sym - 257 >= (int16_t)ARRAY_SIZE(lenBase))
+          _state = ST_ERROR;
+        else                  // length and distance of a match
+        {
+          sym -= 257;
+          _copyLen = pgm_read_word(&lenBase[sym]) + getBits(pgm_read_byte(&lenExtra[sym]));
+          sym = decodeSym(_distCount, _distSym);
+          if (sym < 0 || sym >= (int16_t)ARRAY_SIZE(distBase))
+            _state = ST_ERROR;
+          else
+          {
+            _copyDist = pgm_read_word(&distBase[sym]) + getBits(pgm_read_byte(&distExtra[sym]));
+
+            // too far back for the window, or before the start of the data
+            if (_copyDist > WINDOW_SIZE || _copyDist > _outTotal + n)
+              _state = ST_ERROR;
+          }
+        }
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    // the compressed data must not end before the last block
+    if (_inEof)
+      _state = ST_ERROR;
+  }
+
+  _outTotal += n;
+
+  return(n);
+}
+
+uint16_t MD_SN76489_VGZSource::decompress(void)
+// Decompress a block into the window, up to the end of the window
+{
+  uint16_t len = BLOCK_SIZE;
+
+  if (_wPos == WINDOW_SIZE)
+    _wPos = 0;
+  if (len > WINDOW_SIZE - _wPos)
+    len = WINDOW_SIZE - _wPos;
+
+  _aheadPos = _wPos;
+  _aheadLen = inflate(len);
+
+  return(_aheadLen);
+}
+
+void MD_SN76489_VGZSource::begin(void)
+// Check the first block for the gzip header
+{
+  size_t len = _src.read(_in);
+
+  _inEnd = _in + len;
+  _inPgm = _src.isProgmem();
+  if (len < 2 ||
+    (_inPgm ? pgm_read_byte(&_in[0]) : _in[0]) != 0x1f ||
+    (_inPgm ? pgm_read_byte(&_in[1]) : _in[1]) != 0x8b)
+    _state = ST_RAW;    // not compressed, the block is passed through by read()
+  else
+    _state = readHeader() ? ST_BLOCK : ST_ERROR;
+}
+
+size_t MD_SN76489_VGZSource::read(const uint8_t* &data)
+{
+  size_t len;
+
+  if (_state == ST_START)
+    begin();
+
+  if (_state == ST_RAW)
+  {
+    if (_in != _inEnd)   // the first block, read by begin()
+    {
+      data = _in;
+      len = _inEnd - _in;
+      _in = _inEnd;
+      return(len);
+    }
+    return(_src.read(data));
+  }
+
+  if (_replayLen != 0)  // play again from the window after seek()
+  {
+    len = WINDOW_SIZE - _replayPos;
+    if (len > _replayLen) len = _replayLen;
+    if (len > BLOCK_SIZE) len = BLOCK_SIZE;
+
+    data = _win + _replayPos;
+    _replayPos = (_replayPos + len) & WINDOW_MASK;
+    _replayLen -= len;
+    return(len);
+  }
+
+  if (_aheadLen == 0)   // not decompressed in idle()
+    decompress();
+
+  len = _aheadLen;
+  data = _win + _aheadPos;
+  _aheadLen = 0;
+
+  return(len);
+}
+
+bool MD_SN76489_VGZSource::seek(uint32_t offset)
+{
+  if (_state == ST_START)
+    begin();
+
+  if (_state == ST_RAW)
+    return(_src.seek(offset));
+
+  // Data back to 2 blocks less than the window is still in the window,
+  // as up to a block can be decompressed ahead while it is played again.
+  if (offset + (WINDOW_SIZE - 2 * BLOCK_SIZE) < _outTotal)
+  {
+    if (!_src.seek(0))
+      return(false);
+    reset();
+    begin();
+  }
+
+  // decompress up to the offset
+  while (_outTotal < offset)
+    if (decompress() == 0)
+      return(false);
+
+  // the data from the offset to the end of the last block is played again
+  _aheadLen = 0;
+  _replayPos = offset & WINDOW_MASK;
+  _replayLen = _outTotal - offset;
+
+  return(true);
+}
+
+void MD_SN76489_VGZSource::idle(void)
+{
+  if (_state >= ST_BLOCK && _state <= ST_HUFFMAN && _aheadLen == 0)
+    decompress();
+
+  _src.idle();
+}
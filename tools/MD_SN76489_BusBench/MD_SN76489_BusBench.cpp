@@ -0,0 +1,115 @@
+// MD_SN76489 host tool - transport write path benchmark.
+//
+// Compares the cost of writing bytes to the IC through
+// - the virtual send() methods of a class derived from MD_SN76489, as used
+//   by MD_SN76489_Direct and MD_SN76489_SPI before MD_SN76489_T
+// - the MD_SN76489_T template, where write() calls the transport directly
+// using a transport that stores each byte in a variable in place of the
+// port register. Raw write() calls and register updates with setVolume()
+// (which go through the virtual sendBurst() in both cases) are timed, and
+// the bytes received by each transport are checked to be the same.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_BusBench.cpp ../../src/*.cpp -o busbench
+//
+// Usage: busbench [writes]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <MD_SN76489.h>
+
+volatile uint8_t port;    // stand-in for the port register
+uint32_t sum;             // checksum of all the bytes sent
+
+// Transport for the template
+struct PortBus
+{
+  void begin(void) {}
+  inline void send(const uint8_t* data, size_t len, uint8_t)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      port = data[i];
+      sum += data[i];
+    }
+  }
+};
+
+// The same transport through the virtual methods
+class PortVirtual: public MD_SN76489
+{
+public:
+  PortVirtual(void) : MD_SN76489(false) {}
+
+protected:
+  void send(uint8_t data) { sendBurst(&data, 1); }
+  void sendBurst(const uint8_t* data, size_t len)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      port = data[i];
+      sum += data[i];
+    }
+  }
+};
+
+typedef MD_SN76489_T<PortBus> PortTemplate;
+
+// Keep the compiler from seeing the actual object type, as for an object
+// used through a reference or defined in another file.
+template <class T> __attribute__((noinline)) T& hide(T& S) { __asm__ volatile("" : : "r"(&S) : "memory"); return(S); }
+
+template <class T>
+double benchWrite(T& S, uint32_t writes)
+{
+  uint32_t timeStart = micros();
+
+  for (uint32_t i = 0; i < writes; i++)
+    S.write(0x90 | (i & 0x6f));
+
+  return((micros() - timeStart) / 1e6);
+}
+
+template <class T>
+double benchVolume(T& S, uint32_t writes)
+{
+  uint32_t timeStart = micros();
+
+  for (uint32_t i = 0; i < writes; i++)
+    S.setVolume(i & 3, i & 0xf);
+
+  return((micros() - timeStart) / 1e6);
+}
+
+void report(const char* label, double tVirtual, double tTemplate, uint32_t writes)
+{
+  printf("%-12s virtual %7.2fM/s, template %7.2fM/s (%.2fx)\n", label,
+    writes / tVirtual / 1e6, writes / tTemplate / 1e6, tVirtual / tTemplate);
+}
+
+int main(int argc, char* argv[])
+{
+  uint32_t writes = (argc > 1) ? atol(argv[1]) : 100000000UL;
+  PortVirtual V;
+  PortTemplate T(false);
+  uint32_t sumV, sumT;
+  double tV, tT;
+
+  V.begin();
+  T.begin();
+
+  printf("Writes per second for %u writes\n", writes);
+
+  sum = 0;  tV = benchWrite(hide(V), writes);  sumV = sum;
+  sum = 0;  tT = benchWrite(hide(T), writes);  sumT = sum;
+  report("write()", tV, tT, writes);
+  if (sumV != sumT) printf("Data sent is DIFFERENT\n");
+
+  sum = 0;  tV = benchVolume(hide(V), writes);  sumV = sum;
+  sum = 0;  tT = benchVolume(hide(T), writes);  sumT = sum;
+  report("setVolume()", tV, tT, writes);
+  if (sumV != sumT) printf("Data sent is DIFFERENT\n");
+
+  return(0);
+}
@@ -0,0 +1,249 @@
+// MD_SN76489 host tool - software emulator render benchmark.
+//
+// Renders the same register write sequence (3 tones and noise changing
+// every 1/60s frame) through MD_SN76489_Emu using
+// - getSample() one sample at a time
+// - the scalar block render kernel
+// - the SSE2 block render kernel (if SN_EMU_SIMD is enabled)
+// checks that all the outputs are identical and reports the rendered 
+// seconds of audio per wall clock second for each.
+//
+// The band limited (BLEP) mode is then compared to rendering at 16 times
+// the sample rate and filtering down to the sample rate. As well as the
+// speed, the level of the aliased (inharmonic) frequencies in the spectrum
+// of a high square wave tone is reported for direct, oversampled and BLEP
+// rendering.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_EmuBench.cpp ../../src/*.cpp -o emubench
+//
+// Usage: emubench [seconds [sample rate]]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <complex>
+#include <MD_SN76489.h>
+
+// Expose the render kernels for the benchmark
+class EmuBench: public MD_SN76489_Emu
+{
+public:
+  EmuBench(uint32_t sampleRate) : MD_SN76489_Emu(sampleRate) {};
+
+  using MD_SN76489_Emu::renderScalar;
+#if SN_EMU_SIMD
+  using MD_SN76489_Emu::renderSIMD;
+#endif
+
+  std::vector<int16_t> hist;  // oversampled samples still needed by the filter
+};
+
+// Oversampling reference
+const uint8_t OVERSAMPLE = 16;                // sample rate multiplier
+const uint16_t FIR_TAPS = OVERSAMPLE * 32;    // decimation filter length
+std::vector<float> fir;                       // decimation filter taps
+
+void firInit(void)
+// Windowed sinc low pass filter cut off at 0.45 of the output sample rate
+{
+  const double FC = 0.45 / OVERSAMPLE;
+  double sum = 0.0;
+
+  fir.resize(FIR_TAPS);
+  for (uint16_t k = 0; k < FIR_TAPS; k++)
+  {
+    double x = k - (FIR_TAPS - 1) / 2.0;
+    double w = 0.42 - 0.5 * cos(2 * M_PI * k / (FIR_TAPS - 1)) + 0.08 * cos(4 * M_PI * k / (FIR_TAPS - 1));
+
+    fir[k] = 2 * FC * w * ((x == 0.0) ? 1.0 : sin(2 * M_PI * FC * x) / (2 * M_PI * FC * x));
+    sum += fir[k];
+  }
+  for (uint16_t k = 0; k < FIR_TAPS; k++)
+    fir[k] /= sum;
+}
+
+typedef void (*renderFn_t)(EmuBench& E, int16_t* out, size_t frames);
+
+void renderOne(EmuBench& E, int16_t* out, size_t frames)
+{
+  for (size_t i = 0; i < frames; i++)
+    out[i] = E.getSample();
+}
+
+void renderScalar(EmuBench& E, int16_t* out, size_t frames) { E.renderScalar(out, frames); }
+#if SN_EMU_SIMD
+void renderSIMD(EmuBench& E, int16_t* out, size_t frames) { E.renderSIMD(out, frames); }
+#endif
+
+void renderBLEP(EmuBench& E, int16_t* out, size_t frames)
+{
+  E.setBandLimited(true);
+  E.render(out, frames);
+}
+
+void renderOversampled(EmuBench& E, int16_t* out, size_t frames)
+// Render at OVERSAMPLE times the sample rate and filter every 
+// OVERSAMPLEth sample down to the output rate.
+{
+  if (E.hist.empty())   // first call
+  {
+    E.setSampleRate(E.getSampleRate() * OVERSAMPLE);
+    E.hist.assign(FIR_TAPS, 0);
+  }
+
+  size_t n = E.hist.size();
+
+  E.hist.resize(n + frames * OVERSAMPLE);
+  E.render(&E.hist[n], frames * OVERSAMPLE);
+
+  for (size_t i = 0; i < frames; i++)
+  {
+    const int16_t* h = &E.hist[(i + 1) * OVERSAMPLE];
+    float s = 0.0f;
+
+    for (uint16_t k = 0; k < FIR_TAPS; k++)
+      s += fir[k] * h[k];
+    out[i] = (int16_t)lrintf(s);
+  }
+  E.hist.erase(E.hist.begin(), E.hist.end() - FIR_TAPS);
+}
+
+double run(const char* label, renderFn_t fn, uint32_t seconds, uint32_t sampleRate, std::vector<int16_t>& pcm)
+// Render the test sequence one frame at a time and return the wall time
+{
+  const uint16_t FPS = 60;
+  const size_t frameSamples = sampleRate / FPS;
+  EmuBench E(sampleRate);
+
+  E.begin();
+  pcm.resize((size_t)seconds * FPS * frameSamples);
+
+  uint32_t timeStart = micros();
+  for (uint32_t f = 0; f < seconds * FPS; f++)
+  {
+    // change all the registers every frame
+    E.setFrequency(0, 220 + (f % 64) * 10);
+    E.setFrequency(1, 330 + (f % 48) * 15);
+    E.setFrequency(2, 1000 + (f % 32) * 100);
+    if (f % 8 == 0)
+      E.setNoise((f & 8) ? MD_SN76489::WHITE_3 : MD_SN76489::PERIODIC_1);
+    for (uint8_t c = 0; c < MD_SN76489::MAX_CHANNELS; c++)
+      E.setVolume(c, (f + c * 4) % 16);
+
+    fn(E, &pcm[f * frameSamples], frameSamples);
+  }
+  double wall = (micros() - timeStart) / 1e6;
+
+  printf("%-12s %8.3fs wall, %8.1f rendered s/wall s\n", label, wall, seconds / wall);
+
+  return(wall);
+}
+
+void fft(std::vector<std::complex<double>>& a)
+// In place radix 2 FFT, the size must be a power of 2
+{
+  size_t n = a.size();
+
+  for (size_t i = 1, j = 0; i < n; i++)
+  {
+    size_t b = n >> 1;
+
+    for (; j & b; b >>= 1) j ^= b;
+    j ^= b;
+    if (i < j) std::swap(a[i], a[j]);
+  }
+
+  for (size_t len = 2; len <= n; len <<= 1)
+  {
+    std::complex<double> w = std::polar(1.0, -2 * M_PI / len);
+
+    for (size_t i = 0; i < n; i += len)
+    {
+      std::complex<double> wk = 1.0;
+
+      for (size_t k = 0; k < len / 2; k++, wk *= w)
+      {
+        std::complex<double> u = a[i + k], v = a[i + k + len / 2] * wk;
+
+        a[i + k] = u + v;
+        a[i + k + len / 2] = u - v;
+      }
+    }
+  }
+}
+
+void alias(const char* label, renderFn_t fn, uint32_t sampleRate)
+// Render a high square wave and report the power at frequencies that are 
+// not harmonics of the tone relative to the total power.
+{
+  const size_t N = 16384;
+  const uint16_t DIVIDER = 19;    // 6579Hz, the 3rd harmonic is just below 20kHz
+  const double f0 = 4000000.0 / 32 / DIVIDER;
+  std::vector<int16_t> pcm(2 * N);
+  std::vector<std::complex<double>> a(N);
+  double signal = 0.0, noise = 0.0;
+  EmuBench E(sampleRate);
+
+  E.begin();
+  E.write(0x80 | (DIVIDER & 0xf));
+  E.write(DIVIDER >> 4);
+  E.setVolume(0, 15);
+  fn(E, pcm.data(), pcm.size());
+
+  // Hann window the second half to skip the start up
+  for (size_t i = 0; i < N; i++)
+    a[i] = pcm[N + i] * (0.5 - 0.5 * cos(2 * M_PI * i / N));
+  fft(a);
+
+  for (size_t b = 1; b < N / 2; b++)
+  {
+    double p = std::norm(a[b]);
+    bool harmonic = false;
+
+    for (uint32_t h = 1; h * f0 < sampleRate / 2; h += 2)
+      harmonic |= (fabs(b - h * f0 * N / sampleRate) <= 4);
+
+    (harmonic ? signal : noise) += p;
+  }
+
+  printf("%-12s aliasing %6.1fdB\n", label, 10 * log10(noise / (signal + noise)));
+}
+
+int main(int argc, char* argv[])
+{
+  uint32_t seconds = (argc > 1) ? atol(argv[1]) : 600;
+  uint32_t sampleRate = (argc > 2) ? atol(argv[2]) : 44100;
+  std::vector<int16_t> ref, pcm;
+  bool ok = true;
+
+  printf("Rendering %us of audio at %uHz\n", seconds, sampleRate);
+
+  run("getSample()", renderOne, seconds, sampleRate, ref);
+  run("scalar", renderScalar, seconds, sampleRate, pcm);
+  ok &= (pcm == ref);
+#if SN_EMU_SIMD
+  run("SSE2", renderSIMD, seconds, sampleRate, pcm);
+  ok &= (pcm == ref);
+#else
+  printf("SSE2 kernel not compiled (SN_EMU_SIMD is 0)\n");
+#endif
+
+  printf("Outputs %s\n", ok ? "match" : "DIFFER");
+
+  // band limited rendering
+  firInit();
+  printf("\nBand limited rendering\n");
+  run("direct", renderScalar, seconds, sampleRate, ref);
+  run("16x + FIR", renderOversampled, seconds, sampleRate, pcm);
+  run("BLEP", renderBLEP, seconds, sampleRate, pcm);
+
+  printf("\nAliasing of a %.0fHz square wave\n", 4000000.0 / 32 / 19);
+  alias("direct", renderScalar, sampleRate);
+  alias("16x + FIR", renderOversampled, sampleRate);
+  alias("BLEP", renderBLEP, sampleRate);
+
+  return(ok ? 0 : 1);
+}
@@ -0,0 +1,102 @@
+// MD_SN76489 host tool - ADSR envelope timing check.
+//
+// Plays notes with a set of ADSR envelopes on MD_SN76489_Emu, calling
+// play(now) from a virtual clock at a fixed interval, and watches the 
+// attenuator in the emulated IC to find when each envelope phase ends. 
+// The actual end time of the Attack, Decay and Release phases is reported
+// against the time requested by the envelope and the note duration.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_EnvTiming.cpp ../../src/*.cpp -o envtiming
+// for millisecond timing, or add -DSN_TIME_US=1 for microsecond timing.
+//
+// Usage: envtiming [call interval in us]
+// The default interval is 1000us for millisecond timing and 100us for 
+// microsecond timing. With longer intervals a whole phase of the shorter
+// envelopes can pass between calls and its end is then not seen.
+//
+// The exit status is 0 if all the phase times are within the call interval 
+// plus the timing resolution of the requested time.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <MD_SN76489.h>
+
+MD_SN76489::adsrEnvelope_t adsr[] =
+{
+  { false,  40,  60, 3,  75 },    // library default
+  { false,   5,   5, 3,  10 },    // percussive
+  { false,   1,   2, 5,   8 },    // very short
+  { false,   7,  13, 9,  11 },    // uneven steps
+  { false, 100, 200, 6, 300 },    // slow
+};
+
+const uint8_t VOLUME = MD_SN76489::VOL_MAX;
+const uint16_t SUSTAIN = 50;      // ms of sustain in each note
+
+int main(int argc, char* argv[])
+{
+  const uint32_t US_PER_UNIT = 1000 / SN_TIME_SCALE;   // us per library time unit
+  uint32_t interval = (argc > 1) ? atol(argv[1]) : (SN_TIME_US ? 100 : 1000);
+  double worst = 0.0;
+  MD_SN76489_Emu E;
+
+  if (interval < US_PER_UNIT) interval = US_PER_UNIT;
+  printf("%s timing, play() every %uus\n\n", SN_TIME_US ? "Microsecond" : "Millisecond", interval);
+  printf("   Ta   Td Vs   Tr |  Attack req/act  |   Decay req/act  |    Note req/act\n");
+
+  E.begin();
+
+  for (uint8_t i = 0; i < ARRAY_SIZE(adsr); i++)
+  {
+    uint16_t duration = adsr[i].Ta + adsr[i].Td + SUSTAIN + adsr[i].Tr;
+    uint8_t volSustain = VOLUME - adsr[i].deltaVs;
+    double req[3], act[3] = { -1, -1, -1 };
+    uint8_t phase = 0;
+    uint8_t volPrev = 0;
+
+    E.setADSR(&adsr[i]);
+    E.note(0, 440, VOLUME, duration);
+
+    // the note starts at the first call to play() at time 0
+    for (uint32_t us = 0; phase < 3 && us < 2000000UL; us += interval)
+    {
+      E.play(us / US_PER_UNIT);
+
+      uint8_t vol = MD_SN76489::VOL_MAX - (E.getChipRegs().get(1) & 0xf);
+
+      // Attack ends at full volume, Decay ends at the sustain volume and the
+      // note ends when the volume is off. If the steps are shorter than the 
+      // call interval the full volume may be passed between calls, so the 
+      // Attack has also ended if the volume starts to drop.
+      if ((phase == 0 && (vol == VOLUME || vol < volPrev)) || 
+          (phase == 1 && vol <= volSustain) ||
+          (phase == 2 && vol == MD_SN76489::VOL_OFF))
+        act[phase++] = us / 1000.0;
+      volPrev = vol;
+    }
+
+    req[0] = adsr[i].Ta;
+    req[1] = adsr[i].Ta + adsr[i].Td;
+    req[2] = duration;
+
+    printf("%5u%5u%3u%5u |", adsr[i].Ta, adsr[i].Td, adsr[i].deltaVs, adsr[i].Tr);
+    for (uint8_t p = 0; p < 3; p++)
+    {
+      printf(" %7.1f %7.3f |", req[p], act[p]);
+      if (act[p] < 0)
+        worst = 1e9;
+      else if (fabs(act[p] - req[p]) > worst)
+        worst = fabs(act[p] - req[p]);
+    }
+    printf("\n");
+  }
+
+  bool ok = (worst * 1000 <= interval + US_PER_UNIT);
+
+  printf("\nWorst case error %.3fms: %s\n", worst, ok ? "PASS" : "FAIL");
+
+  return(ok ? 0 : 1);
+}
@@ -0,0 +1,123 @@
+// MD_SN76489 host tool - tone divider calculation check and benchmark.
+//
+// setFrequency() works out the tone divider clock/(32*f) using a table
+// reciprocal of f instead of a 32 bit divide. For a set of IC clocks this
+// tool
+// - checks that the divider written to the IC for every frequency
+//   [0..65535] is the same as the divide, limited to [1..1023]
+// - times setFrequency() against setDivider() with the divider worked out
+//   by a 32 bit divide (the calculation used before) and reports the time
+//   per call for each.
+//
+// The reciprocal is there for MCUs without a hardware divide, such as the
+// AVR where a 32 bit divide is a library call of several hundred cycles. 
+// Host processors divide in hardware, so on the host the reciprocal is 
+// expected to be a little slower than the divide.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_FreqBench.cpp ../../src/*.cpp -o freqbench
+//
+// Usage: freqbench [calls]
+//
+// The exit status is 0 if all the dividers are correct.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <MD_SN76489.h>
+
+// Keep a copy of the IC registers instead of sending the data anywhere
+class FreqBench: public MD_SN76489
+{
+public:
+  FreqBench(void) : MD_SN76489(false) {};
+
+  uint16_t divider(void) { return(_ic.get(0)); }
+
+  MD_SN76489_Regs _ic;
+
+protected:
+  void send(uint8_t data) { _ic.decode(data); }
+};
+
+const uint32_t clocks[] = { 4000000UL, 3579545UL, 3546893UL, 2000000UL, 1000000UL, 500000UL };
+
+uint16_t refDivider(uint32_t clock, uint16_t freq)
+// The divide used before, limited to the 10 bit divider
+{
+  uint32_t n = (freq == 0) ? 0xffff : clock / ((uint32_t)freq << 5);
+
+  if (n < 1) n = 1;
+  if (n > 1023) n = 1023;
+
+  return(n);
+}
+
+bool check(uint32_t clock)
+{
+  FreqBench S;
+  uint32_t errors = 0;
+
+  S.begin(clock);
+  for (uint32_t f = 0; f <= 0xffff; f++)
+  {
+    S.setFrequency(0, f);
+    if (S.divider() != refDivider(clock, f))
+    {
+      if (errors++ < 5)
+        printf("  %uHz: divider %u expected %u\n", f, S.divider(), refDivider(clock, f));
+    }
+  }
+
+  printf("%8uHz clock: %s", clock, errors ? "" : "all dividers correct");
+  if (errors) printf("%u dividers wrong", errors);
+  printf("\n");
+
+  return(errors == 0);
+}
+
+void bench(uint32_t clock, uint32_t calls)
+{
+  FreqBench S;
+  uint32_t timeStart;
+  double tDiv, tRecip;
+
+  S.begin(clock);
+
+  // notes from 110Hz to 3.5kHz, a different frequency each call
+  timeStart = micros();
+  for (uint32_t i = 0; i < calls; i++)
+  {
+    volatile uint16_t f = 110 + (i % 3400);
+
+    S.setDivider(i & 1, clock / ((uint32_t)f << 5));
+  }
+  tDiv = (double)(micros() - timeStart) * 1000.0 / calls;
+
+  timeStart = micros();
+  for (uint32_t i = 0; i < calls; i++)
+  {
+    volatile uint16_t f = 110 + (i % 3400);
+
+    S.setFrequency(i & 1, f);
+  }
+  tRecip = (double)(micros() - timeStart) * 1000.0 / calls;
+
+  printf("%8uHz clock: divide %6.2fns/call, reciprocal %6.2fns/call\n", clock, tDiv, tRecip);
+}
+
+int main(int argc, char* argv[])
+{
+  uint32_t calls = (argc > 1) ? atol(argv[1]) : 20000000UL;
+  bool ok = true;
+
+  printf("Tone dividers for all frequencies\n");
+  for (uint8_t i = 0; i < ARRAY_SIZE(clocks); i++)
+    ok &= check(clocks[i]);
+
+  printf("\nsetFrequency() time per call (%u calls)\n", calls);
+  for (uint8_t i = 0; i < ARRAY_SIZE(clocks); i++)
+    bench(clocks[i], calls);
+
+  return(ok ? 0 : 1);
+}
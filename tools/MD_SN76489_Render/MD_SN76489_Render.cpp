@@ -0,0 +1,211 @@
+// MD_SN76489 host tool - render a tune faster than real time.
+//
+// Plays a tune with ADSR envelopes on MD_SN76489_Emu, driving the library
+// with play(now) from a virtual clock. The clock is advanced directly to
+// the next envelope event (from nextEventMs()) or note and the audio up to
+// that time is rendered in one block. The audio is written to a 16 bit 
+// mono WAV file and a checksum of the audio is printed. As the virtual 
+// clock does not depend on the host timing, the checksum is the same for
+// every run.
+//
+// If a VGM file name is given, the library writes are also recorded to it
+// by MD_SN76489_VGMRecorder, timed by the same virtual clock. The VGM file
+// is the same for every run and plays with vgmplay to the same checksum.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_Render.cpp ../../src/*.cpp -o render
+//
+// Usage: render [file.wav [seconds [sample rate [file.vgm]]]]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <MD_SN76489.h>
+
+// Tune data - frequency and duration in ms for each of the 3 tone channels.
+// Frequency 0 is a rest.
+struct noteDef_t
+{
+  uint16_t freq;
+  uint16_t duration;
+};
+
+const noteDef_t melody[] =
+{
+  { 523, 250 }, { 587, 250 }, { 659, 250 }, { 698, 250 },
+  { 784, 500 }, { 784, 500 }, { 880, 250 }, { 880, 250 },
+  { 880, 250 }, { 880, 250 }, { 784, 1000 }, { 0, 250 },
+  { 698, 250 }, { 698, 250 }, { 698, 250 }, { 698, 250 },
+  { 659, 500 }, { 659, 500 }, { 587, 250 }, { 587, 250 },
+  { 587, 250 }, { 587, 250 }, { 523, 1000 }, { 0, 250 },
+};
+
+const noteDef_t harmony[] =
+{
+  { 262, 1000 }, { 392, 1000 }, { 349, 1000 }, { 392, 1000 },
+  { 349, 1000 }, { 262, 1000 }, { 294, 1000 }, { 262, 1000 },
+};
+
+const noteDef_t bass[] =
+{
+  { 131, 500 }, { 0, 500 }, { 196, 500 }, { 0, 500 },
+  { 175, 500 }, { 0, 500 }, { 196, 500 }, { 0, 500 },
+};
+
+struct track_t
+{
+  const noteDef_t* notes;
+  size_t count;
+  size_t next;
+  uint32_t timeNext;
+};
+
+track_t track[] =
+{
+  { melody, ARRAY_SIZE(melody), 0, 0 },
+  { harmony, ARRAY_SIZE(harmony), 0, 0 },
+  { bass, ARRAY_SIZE(bass), 0, 0 },
+};
+
+MD_SN76489::adsrEnvelope_t adsr = { false, 20, 30, 3, 60 };
+
+// VGM recording to a file
+class VGMFile: public MD_SN76489_VGMSink
+{
+public:
+  VGMFile(FILE* f) : _f(f) {}
+  size_t write(const uint8_t* data, size_t len) { return(fwrite(data, 1, len, _f)); }
+  bool seek(uint32_t offset) { return(fseek(_f, offset, SEEK_SET) == 0); }
+
+private:
+  FILE* _f;
+};
+
+void writeLE(FILE* f, uint32_t v, uint8_t size)
+{
+  for (uint8_t i = 0; i < size; i++)
+    fputc((v >> (8 * i)) & 0xff, f);
+}
+
+void writeWav(const char* name, const std::vector<int16_t>& pcm, uint32_t sampleRate)
+{
+  FILE* f = fopen(name, "wb");
+
+  if (f == NULL)
+  {
+    printf("Cannot create %s\n", name);
+    return;
+  }
+
+  uint32_t bytes = pcm.size() * sizeof(int16_t);
+
+  fwrite("RIFF", 1, 4, f);  writeLE(f, 36 + bytes, 4);
+  fwrite("WAVEfmt ", 1, 8, f);
+  writeLE(f, 16, 4);              // fmt chunk size
+  writeLE(f, 1, 2);               // PCM
+  writeLE(f, 1, 2);               // mono
+  writeLE(f, sampleRate, 4);
+  writeLE(f, sampleRate * 2, 4);  // bytes per second
+  writeLE(f, 2, 2);               // bytes per sample
+  writeLE(f, 16, 2);              // bits per sample
+  fwrite("data", 1, 4, f);  writeLE(f, bytes, 4);
+  for (size_t i = 0; i < pcm.size(); i++)
+    writeLE(f, (uint16_t)pcm[i], 2);
+
+  fclose(f);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* fileName = (argc > 1) ? argv[1] : "render.wav";
+  uint32_t seconds = (argc > 2) ? atol(argv[2]) : 180;
+  uint32_t sampleRate = (argc > 3) ? atol(argv[3]) : 44100;
+  const char* vgmName = (argc > 4) ? argv[4] : NULL;
+  FILE* vgm = (vgmName != NULL) ? fopen(vgmName, "wb") : NULL;
+  MD_SN76489_Emu E(sampleRate);
+  VGMFile sink(vgm);
+  MD_SN76489_VGMRecorder R(E, sink);   // passes the writes on to E
+  std::vector<int16_t> pcm((uint64_t)seconds * sampleRate);
+  uint32_t hash = 2166136261UL;   // FNV-1a
+
+  R.begin();
+  R.setADSR(&adsr);
+  if (vgmName != NULL && vgm == NULL)
+  {
+    printf("Cannot create %s\n", vgmName);
+    return(1);
+  }
+  if (vgm != NULL)
+  {
+    R.setTime(0);
+    R.start();
+  }
+
+  uint32_t timeStart = micros();
+  size_t rendered = 0;
+  uint32_t events = 0;
+
+  for (uint32_t now = 0; now < seconds * 1000; )
+  {
+    uint32_t next;
+
+    R.setTime(now * 1000);
+    // start the next note on each track when it is due
+    for (uint8_t t = 0; t < ARRAY_SIZE(track); t++)
+    {
+      if (now >= track[t].timeNext)
+      {
+        const noteDef_t* n = &track[t].notes[track[t].next];
+
+        if (n->freq != 0)
+          R.note(t, n->freq, MD_SN76489::VOL_MAX - 3 * t, n->duration);
+        track[t].timeNext += n->duration;
+        track[t].next = (track[t].next + 1) % track[t].count;
+      }
+    }
+
+    R.play(now);
+
+    // skip ahead to the next envelope event or note, at least 1ms
+    next = R.nextEventMs(now);
+    for (uint8_t t = 0; t < ARRAY_SIZE(track); t++)
+      if (track[t].timeNext - now < next)
+        next = track[t].timeNext - now;
+    if (next == 0) next = 1;
+    if (next > seconds * 1000 - now) next = seconds * 1000 - now;
+    now += next;
+    events++;
+
+    // render up to the new time
+    size_t end = ((uint64_t)now * sampleRate) / 1000;
+
+    E.render(&pcm[rendered], end - rendered);
+    rendered = end;
+  }
+
+  double wall = (micros() - timeStart) / 1e6;
+
+  for (size_t i = 0; i < pcm.size(); i++)
+  {
+    hash = (hash ^ (pcm[i] & 0xff)) * 16777619UL;
+    hash = (hash ^ ((uint16_t)pcm[i] >> 8)) * 16777619UL;
+  }
+
+  printf("Rendered %us at %uHz in %.3fs (%.0fx real time)\n", seconds, sampleRate, wall, seconds / wall);
+  printf("Checksum %08x, play() called %u times\n", hash, events);
+
+  writeWav(fileName, pcm, sampleRate);
+
+  if (vgm != NULL)
+  {
+    R.setTime(seconds * 1000000);
+    if (!R.stop())
+      printf("Cannot write %s\n", vgmName);
+    else
+      printf("Recorded %u writes, %u samples in %u bytes to %s\n", R.getWrites(), R.getSamples(), R.getLength(), vgmName);
+    fclose(vgm);
+  }
+
+  return(0);
+}
@@ -0,0 +1,580 @@
+// MD_SN76489 host tool - strip redundant SN76489 writes from a VGM file.
+//
+// Many VGM files write the same tone and attenuator values again every
+// frame and use chains of short waits, which costs bus time when played
+// and space on the SD card. This tool works through the VGM commands,
+// following the IC state with MD_SN76489_Regs, and writes a VGM file that
+// plays the same with fewer bytes:
+// - the SN76489 writes between two waits are made into one group holding
+//   only the registers that changed. A tone register that only changed
+//   its lower 4 bits is written with a latch byte alone, and one that
+//   only changed its upper 6 bits with a data byte alone if it is still 
+//   latched. Noise control writes are always kept, as they reset the 
+//   noise shift register.
+// - writes in the loop are kept if they change the IC either the first
+//   time through or when the loop is played again from the end state.
+// - waits with nothing between them are merged and written in the
+//   shortest form.
+// - commands for other ICs, the second SN76489, data blocks and the GD3
+//   tag are kept as they are. The header is updated for the new offsets.
+//
+// If the new file would be no smaller, the input is written unchanged.
+//
+// The new file is then checked by playing both files with MD_SN76489_VGM,
+// twice through the loop, and comparing the IC registers at every sample
+// and after seek() to random times. The byte, write and wait command
+// counts and the bus time for the SN76489 writes are printed for both.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_VGMOpt.cpp ../../src/*.cpp -o vgmopt
+//
+// Usage: vgmopt file.vgm|file.vgz [file.vgm]
+//
+// Compressed files are written uncompressed. The output file name defaults
+// to the input file name with _opt added. The exit status is 0 if the new
+// file played the same.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <MD_SN76489.h>
+
+const uint32_t SAMPLE_RATE = MD_SN76489_VGM::SAMPLE_RATE;
+const uint8_t REG_COUNT = MD_SN76489_Regs::REG_COUNT;
+const uint8_t NOISE_REG = MD_SN76489_Regs::NOISE_REG;
+
+// VGM header offsets
+const uint32_t HDR_EOF = 0x04;      // relative offset to the end of file
+const uint32_t HDR_VERSION = 0x08;
+const uint32_t HDR_GD3 = 0x14;      // relative offset to the GD3 tag
+const uint32_t HDR_LOOP = 0x1c;     // relative offset to the loop point
+const uint32_t HDR_DATA = 0x34;     // relative offset to the data
+const uint32_t HDR_SIZE = 0x40;     // smallest header
+
+const uint8_t LATCH = 0x80;         // latch byte flag
+const uint8_t WRITE_CYCLES = 32;    // IC clock cycles for each write
+const uint16_t SEEK_CHECKS = 50;    // random seeks checked
+const uint8_t STOP_WRITES = 4;      // attenuators turned off by stop()
+
+struct write_t
+{
+  uint32_t sample;  // sample the byte is sent at
+  uint8_t data;     // byte sent to the IC
+};
+
+struct count_t
+{
+  uint32_t writes;  // SN76489 writes
+  uint32_t waits;   // wait commands
+};
+
+class MD_SN76489_Log: public MD_SN76489
+// Logs the bytes sent with the sample set by the caller
+{
+public:
+  MD_SN76489_Log(bool keep = true) : MD_SN76489(false), sample(0), _keep(keep)
+  {
+    begin();      // resets the register model, turning the attenuators off
+    log.clear();
+  }
+
+  std::vector<write_t> log;
+  uint32_t sample;
+
+protected:
+  void send(uint8_t data) { if (_keep) log.push_back({ sample, data }); }
+
+private:
+  bool _keep;
+};
+
+uint32_t getLE(const std::vector<uint8_t>& d, uint32_t pos)
+{
+  return(d[pos] | (d[pos + 1] << 8) | (d[pos + 2] << 16) | ((uint32_t)d[pos + 3] << 24));
+}
+
+void setLE(std::vector<uint8_t>& d, uint32_t pos, uint32_t v)
+{
+  for (uint8_t i = 0; i < 4; i++)
+    d[pos + i] = (v >> (8 * i)) & 0xff;
+}
+
+uint32_t cmdSize(const std::vector<uint8_t>& d, uint32_t pos)
+// Bytes in the command at pos, including the operands
+{
+  uint8_t cmd = d[pos];
+
+  if (cmd == 0x67)      // 0x67 0x66 tt ss ss ss ss : data block
+    return(pos + 7 <= d.size() ? 7 + getLE(d, pos + 3) : 1);
+  if (cmd == 0x68) return(12);
+  if (cmd == 0x61) return(3);
+  if ((cmd >= 0x30 && cmd <= 0x3f) || cmd == 0x4f || cmd == 0x50 || cmd == 0x94) return(2);
+  if ((cmd >= 0x40 && cmd <= 0x4e) || (cmd >= 0x51 && cmd <= 0x5f) || (cmd >= 0xa0 && cmd <= 0xbf)) return(3);
+  if (cmd >= 0xc0 && cmd <= 0xdf) return(4);
+  if (cmd == 0x90 || cmd == 0x91 || cmd == 0x95 || cmd >= 0xe0) return(5);
+  if (cmd == 0x92) return(6);
+  if (cmd == 0x93) return(11);
+
+  return(1);
+}
+
+uint32_t waitSamples(const std::vector<uint8_t>& d, uint32_t pos)
+// Samples waited by the command at pos, 0 if it is not a wait command
+{
+  uint8_t cmd = d[pos];
+
+  if (cmd == 0x61) return(d[pos + 1] | (d[pos + 2] << 8));
+  if (cmd == 0x62) return(735);
+  if (cmd == 0x63) return(882);
+  if (cmd >= 0x70 && cmd <= 0x7f) return((cmd & 0xf) + 1);
+
+  return(0);
+}
+
+uint8_t regOf(uint8_t data, const MD_SN76489_Regs& regs)
+// Register written by a byte
+{
+  return((data & LATCH) ? (data >> 4) & 7 : regs.getLatched());
+}
+
+class Optimizer
+// Writes the optimized command stream
+{
+public:
+  Optimizer(std::vector<uint8_t>& out, const MD_SN76489_Regs& endState) :
+    _out(out), _wait(0), _touched(0), _written(0), _inLoop(false),
+    _latched(false), _loopLatched(false)
+  {
+    _target.reset();
+    _chip.reset();
+    _chipLoop = endState;   // the state when the loop is played again
+    _count = { 0, 0 };
+  }
+
+  void write(uint8_t data)
+  // An SN76489 write, at the time of the pending wait
+  {
+    uint8_t r = regOf(data, _target);
+
+    _touched |= (1 << r);
+    if (_inLoop) _written |= (1 << r);
+    _target.decode(data);
+  }
+
+  void wait(uint32_t samples) { group(); _wait += samples; }
+
+  void copy(const uint8_t* cmd, uint32_t len)
+  // Any other command, kept in its place
+  {
+    group();
+    putWait();
+    _out.insert(_out.end(), cmd, cmd + len);
+  }
+
+  void loopPoint(void)
+  // Start of the loop, the next command written is the loop point
+  {
+    group();
+    putWait();
+    _inLoop = true;
+  }
+
+  const count_t& getCount(void) { return(_count); }
+
+private:
+  std::vector<uint8_t>& _out;
+  MD_SN76489_Regs _target;    // IC state from the file
+  MD_SN76489_Regs _chip;      // IC state from the writes kept
+  MD_SN76489_Regs _chipLoop;  // IC state from the writes kept, when the loop is played again
+  uint32_t _wait;             // samples waited since the last command written
+  uint8_t _touched;           // bit per register written in this group
+  uint8_t _written;           // bit per register written since the loop point
+  bool _inLoop;
+  bool _latched;              // true once a latch byte is written, so the IC latch is known
+  bool _loopLatched;          // true once a latch byte is written in the loop
+  count_t _count;
+
+  void put(uint8_t data)
+  // the wait is only written before a write that is kept, so that waits
+  // either side of writes that are left out are merged
+  {
+    putWait();
+    _out.push_back(0x50);
+    _out.push_back(data);
+    _chip.decode(data);
+    if (_inLoop) _chipLoop.decode(data);
+    if (data & LATCH)
+    {
+      _latched = true;
+      _loopLatched |= _inLoop;
+    }
+    _count.writes++;
+  }
+
+  void group(void)
+  // Write the registers changed by this group of writes
+  {
+    for (uint8_t r = 0; r < REG_COUNT; r++)
+    {
+      uint16_t v = _target.get(r);
+
+      if (!(_touched & (1 << r)))
+        continue;
+      if (!_target.isKnown(r))
+      {
+        // tone register with only the lower bits written, keep the latch
+        put(LATCH | (r << 4) | (v & 0xf));
+        continue;
+      }
+
+      bool change = !_chip.isKnown(r) || _chip.get(r) != v || r == NOISE_REG;
+      bool full = !_chip.isKnown(r) || (_chip.get(r) >> 4) != (v >> 4);
+      bool low = !_chip.isKnown(r) || ((_chip.get(r) ^ v) & 0xf) != 0;
+      bool latched = _latched && _chip.getLatched() == r;
+
+      if (_inLoop && (_written & (1 << r)))
+      {
+        change |= !_chipLoop.isKnown(r) || _chipLoop.get(r) != v;
+        full |= !_chipLoop.isKnown(r) || (_chipLoop.get(r) >> 4) != (v >> 4);
+        low |= !_chipLoop.isKnown(r) || ((_chipLoop.get(r) ^ v) & 0xf) != 0;
+      }
+      if (_inLoop)    // the IC latch must be the same the first time and when looping
+        latched = latched && _loopLatched && _chipLoop.getLatched() == r;
+      if (!change)
+        continue;
+
+      // upper bits only, with the register still latched
+      if (MD_SN76489_Regs::isTone(r) && full && !low && latched)
+      {
+        put(v >> 4);
+        continue;
+      }
+
+      put(LATCH | (r << 4) | (v & 0xf));
+      if (MD_SN76489_Regs::isTone(r) && full)
+        put(v >> 4);
+    }
+    _touched = 0;
+  }
+
+  void putWait(void)
+  // Shortest wait commands for the samples waited
+  {
+    static const uint16_t SHORT[] = { 735, 882 };
+
+    while (_wait > 0)
+    {
+      uint32_t w = _wait;
+      uint8_t cmd[3];
+      uint8_t len = 0;
+
+      // one or two single byte commands, if they add up
+      for (uint8_t i = 0; i < 2 && len == 0; i++)
+      {
+        if (w == SHORT[i]) { cmd[0] = 0x62 + i; len = 1; }
+        else if (w > SHORT[i] && w - SHORT[i] <= 16) { cmd[0] = 0x62 + i; cmd[1] = 0x70 + w - SHORT[i] - 1; len = 2; }
+        for (uint8_t j = 0; j < 2 && len == 0; j++)
+          if (w == SHORT[i] + SHORT[j]) { cmd[0] = 0x62 + i; cmd[1] = 0x62 + j; len = 2; }
+      }
+      if (len == 0 && w <= 16) { cmd[0] = 0x70 + w - 1; len = 1; }
+      if (len == 0 && w <= 32) { cmd[0] = 0x7f; cmd[1] = 0x70 + w - 17; len = 2; }
+      if (len == 0)
+      {
+        if (w > 0xffff) w = 0xffff;
+        cmd[0] = 0x61;
+        cmd[1] = w & 0xff;
+        cmd[2] = w >> 8;
+        len = 3;
+      }
+
+      _out.insert(_out.end(), cmd, cmd + len);
+      _count.waits += (len == 3) ? 1 : len;
+      _wait -= w;
+    }
+  }
+};
+
+uint32_t sampleTime(uint32_t sample)
+// micros() time of a sample, rounded up so that the command is due
+{
+  return(((uint64_t)sample * 1000000 + SAMPLE_RATE - 1) / SAMPLE_RATE);
+}
+
+uint32_t play(MD_SN76489_VGM& V, MD_SN76489_Log* L)
+// Play to the end as fast as possible, moving the virtual clock straight
+// to the time of the next write. Returns the number of samples played.
+{
+  uint32_t now = 0, last = 0, looped = 0;
+
+  while (V.poll(now))
+  {
+    uint32_t pos = V.getSamplePos();
+
+    if (pos < last)   // gone back to the loop point
+      looped += V.getLoopSamples();
+    last = pos;
+    pos += looped;
+    if (L != NULL) L->sample = pos;
+    now = (sampleTime(pos) > now) ? sampleTime(pos) : now + 1;
+  }
+
+  // leave out the attenuator writes from stop(), which are not in the file
+  if (L != NULL && L->log.size() >= STOP_WRITES)
+    L->log.resize(L->log.size() - STOP_WRITES);
+
+  return(V.getSamplePos() + looped);
+}
+
+bool sameRegs(const MD_SN76489_Regs& a, const MD_SN76489_Regs& b)
+// Registers known in a have the same value in b
+{
+  for (uint8_t r = 0; r < REG_COUNT; r++)
+    if (a.isKnown(r) && (!b.isKnown(r) || a.get(r) != b.get(r)))
+      return(false);
+
+  return(true);
+}
+
+uint32_t compareLogs(const std::vector<write_t>& a, const std::vector<write_t>& b)
+// Count the samples where the registers played from b differ from a, or a
+// noise register write in a is not in b.
+{
+  MD_SN76489_Regs ra, rb;
+  size_t i = 0, j = 0;
+  uint32_t errors = 0;
+
+  ra.reset();
+  rb.reset();
+  while (i < a.size() || j < b.size())
+  {
+    uint32_t s = (j >= b.size() || (i < a.size() && a[i].sample < b[j].sample)) ? a[i].sample : b[j].sample;
+    bool noiseA = false, noiseB = false;
+
+    for (; i < a.size() && a[i].sample == s; i++)
+    {
+      noiseA |= (regOf(a[i].data, ra) == NOISE_REG);
+      ra.decode(a[i].data);
+    }
+    for (; j < b.size() && b[j].sample == s; j++)
+    {
+      noiseB |= (regOf(b[j].data, rb) == NOISE_REG);
+      rb.decode(b[j].data);
+    }
+    if (!sameRegs(ra, rb) || (noiseA && !noiseB))
+    {
+      if (errors == 0) printf("First difference at sample %u\n", s);
+      errors++;
+    }
+  }
+
+  return(errors);
+}
+
+count_t countCommands(const std::vector<uint8_t>& d, uint32_t pos)
+// SN76489 writes and wait commands in the data from pos
+{
+  count_t c = { 0, 0 };
+
+  while (pos < d.size() && d[pos] != 0x66)
+  {
+    c.writes += (d[pos] == 0x50);
+    c.waits += (waitSamples(d, pos) != 0 || d[pos] == 0x61);
+    pos += cmdSize(d, pos);
+  }
+
+  return(c);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: vgmopt file.vgm|file.vgz [file.vgm]\n");
+    return(1);
+  }
+
+  const char* inName = argv[1];
+  std::string outName;
+  FILE* f = fopen(inName, "rb");
+  std::vector<uint8_t> file;
+  int c;
+
+  if (argc > 2)
+    outName = argv[2];
+  else
+  {
+    const char* slash = strrchr(inName, '/');
+    const char* dot = strrchr(inName, '.');
+
+    outName = (dot != NULL && (slash == NULL || dot > slash)) ? std::string(inName, dot - inName) : inName;
+    outName += "_opt.vgm";
+  }
+
+  if (f == NULL)
+  {
+    printf("Cannot open %s\n", inName);
+    return(1);
+  }
+  while ((c = fgetc(f)) != EOF)
+    file.push_back(c);
+  fclose(f);
+
+  // decompress if needed
+  MD_SN76489_VGMMemory mem(file.data(), file.size());
+  static MD_SN76489_VGZSource src(mem);   // passes uncompressed data through
+  std::vector<uint8_t> vgm;
+  const uint8_t* p;
+  size_t n;
+
+  while ((n = src.read(p)) != 0)
+  {
+    vgm.insert(vgm.end(), p, p + n);
+    src.idle();
+  }
+  if (src.isError() || vgm.size() < HDR_SIZE || memcmp(&vgm[0], "Vgm ", 4) != 0)
+  {
+    printf("%s is not a VGM file%s\n", inName, src.isError() ? " (error in the compressed data)" : "");
+    return(1);
+  }
+
+  // where things are in the file
+  uint32_t version = getLE(vgm, HDR_VERSION);
+  uint32_t dataPos = (version < 0x150 || getLE(vgm, HDR_DATA) == 0) ? HDR_SIZE : getLE(vgm, HDR_DATA) + HDR_DATA;
+  uint32_t loopPos = (getLE(vgm, HDR_LOOP) != 0) ? getLE(vgm, HDR_LOOP) + HDR_LOOP : 0;
+  uint32_t gd3Pos = (getLE(vgm, HDR_GD3) != 0) ? getLE(vgm, HDR_GD3) + HDR_GD3 : 0;
+  uint32_t pos;
+
+  if (dataPos < HDR_SIZE || dataPos >= vgm.size())
+  {
+    printf("%s has no data\n", inName);
+    return(1);
+  }
+
+  // the IC state at the end of the data
+  MD_SN76489_Regs endState;
+
+  endState.reset();
+  for (pos = dataPos; pos < vgm.size() && vgm[pos] != 0x66; pos += cmdSize(vgm, pos))
+    if (vgm[pos] == 0x50 && pos + 1 < vgm.size())
+      endState.decode(vgm[pos + 1]);
+
+  // optimize the data
+  std::vector<uint8_t> opt(vgm.begin(), vgm.begin() + dataPos);
+  Optimizer O(opt, endState);
+  uint32_t newLoop = 0;
+
+  for (pos = dataPos; pos < vgm.size(); )
+  {
+    uint32_t len = cmdSize(vgm, pos);
+    uint8_t cmd = vgm[pos];
+
+    if (pos + len > vgm.size())
+      break;
+    if (pos == loopPos)
+    {
+      O.loopPoint();
+      newLoop = opt.size();
+    }
+
+    if (cmd == 0x66)
+      break;
+    else if (cmd == 0x50)
+      O.write(vgm[pos + 1]);
+    else if (waitSamples(vgm, pos) != 0 || cmd == 0x61)
+      O.wait(waitSamples(vgm, pos));
+    else
+      O.copy(&vgm[pos], len);
+    pos += len;
+  }
+  O.copy((const uint8_t*)"\x66", 1);
+
+  // anything after the data, eg the GD3 tag
+  uint32_t after = opt.size();
+
+  if (pos < vgm.size())
+    opt.insert(opt.end(), vgm.begin() + pos + 1, vgm.end());
+  setLE(opt, HDR_EOF, opt.size() - HDR_EOF);
+  setLE(opt, HDR_LOOP, (loopPos != 0 && newLoop != 0) ? newLoop - HDR_LOOP : 0);
+  if (gd3Pos > pos)
+    setLE(opt, HDR_GD3, gd3Pos - (pos + 1) + after - HDR_GD3);
+
+  // no smaller, keep the file as it is
+  bool unchanged = (opt.size() >= vgm.size());
+  count_t before = countCommands(vgm, dataPos);
+  count_t now = O.getCount();
+
+  if (unchanged)
+  {
+    opt = vgm;
+    now = before;
+  }
+
+  f = fopen(outName.c_str(), "wb");
+  if (f == NULL || fwrite(opt.data(), 1, opt.size(), f) != opt.size())
+  {
+    printf("Cannot write %s\n", outName.c_str());
+    return(1);
+  }
+  fclose(f);
+
+  // savings, negative if the file grew
+  int32_t savedBytes = (int32_t)vgm.size() - (int32_t)opt.size();
+  int32_t savedWrites = (int32_t)before.writes - (int32_t)now.writes;
+  int32_t savedWaits = (int32_t)before.waits - (int32_t)now.waits;
+  uint32_t clockHz = getLE(vgm, 0x0c) & 0x3fffffff;
+
+  if (clockHz == 0) clockHz = 3579545;
+  printf("%s: %zu bytes, %u writes, %u wait commands\n", inName, vgm.size(), before.writes, before.waits);
+  printf("%s: %zu bytes, %u writes, %u wait commands\n", outName.c_str(), opt.size(), now.writes, now.waits);
+  if (unchanged)
+    printf("No smaller, written unchanged\n");
+  printf("Saved %d bytes (%.1f%%), %d writes (%.1f%%), %d wait commands\n",
+    savedBytes, 100.0 * savedBytes / vgm.size(),
+    savedWrites, before.writes ? 100.0 * savedWrites / before.writes : 0.0, savedWaits);
+  printf("Bus time %.1fms, was %.1fms (%u IC clock cycles for each write)\n",
+    1000.0 * now.writes * WRITE_CYCLES / clockHz, 1000.0 * before.writes * WRITE_CYCLES / clockHz, WRITE_CYCLES);
+
+  // check that both files play the same, twice through the loop
+  MD_SN76489_VGMMemory memA(vgm.data(), vgm.size()), memB(opt.data(), opt.size());
+  MD_SN76489_Log LA, LB;
+  MD_SN76489_VGM VA(LA), VB(LB);
+  uint32_t errors;
+
+  VA.setLoops(1);
+  VB.setLoops(1);
+  if (!VA.start(memA) || !VB.start(memB))
+  {
+    printf("Cannot play the files to check them\n");
+    return(1);
+  }
+
+  uint32_t loopedSamples = play(VA, &LA);
+  uint32_t onceSamples = VA.getTotalSamples();
+
+  errors = (play(VB, &LB) != loopedSamples);
+  errors += compareLogs(LA.log, LB.log);
+  printf("Played %u samples, %zu and %zu bytes written\n", loopedSamples, LA.log.size(), LB.log.size());
+
+  // seek both files to random times in the first time through, and compare the registers
+  srand(1);
+  for (uint16_t i = 0; i < SEEK_CHECKS && onceSamples != 0; i++)
+  {
+    uint32_t s = ((uint64_t)rand() * onceSamples) / ((uint64_t)RAND_MAX + 1);
+    MD_SN76489_Log SA(false), SB(false);
+    MD_SN76489_VGM V1(SA), V2(SB);
+
+    memA.reset();
+    memB.reset();
+    if (!V1.start(memA) || !V2.start(memB) || V1.seek(s) != V2.seek(s) || !sameRegs(SA.getRegs(), SB.getRegs()))
+    {
+      if (errors == 0) printf("Different after seek to sample %u\n", s);
+      errors++;
+    }
+  }
+  printf("Check %s (%u seeks)\n", errors == 0 ? "OK" : "FAILED", SEEK_CHECKS);
+
+  return(errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,166 @@
+// MD_SN76489 host tool - render a VGM file to a WAV file.
+//
+// The VGM file is memory mapped and played in place by MD_SN76489_VGM
+// through MD_SN76489_VGMMemory, so the player walks the mapped pages
+// directly with no file reads or copies. Compressed (.vgz) files are
+// decompressed as they are played by MD_SN76489_VGZSource. The music is 
+// played on MD_SN76489_Emu, driving poll(now) from a virtual clock that
+// is moved on a sample at a time, and the audio is written to a 16 bit
+// mono WAV file. The time taken and a checksum of the audio are printed.
+//
+// The loop in the file is played the number of times given by -l. With 
+// -s, play starts at the given time using seek() and the time taken by
+// the seek is printed.
+//
+// Build on the host (POSIX) from this folder with
+//   g++ -O2 -I../../src MD_SN76489_VGMPlay.cpp ../../src/*.cpp -o vgmplay
+//
+// Usage: vgmplay [-l loops] [-s seconds] file.vgm|file.vgz [file.wav]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <MD_SN76489.h>
+
+const uint32_t SAMPLE_RATE = MD_SN76489_VGM::SAMPLE_RATE;
+
+void writeLE(FILE* f, uint32_t v, uint8_t size)
+{
+  for (uint8_t i = 0; i < size; i++)
+    fputc((v >> (8 * i)) & 0xff, f);
+}
+
+void writeWav(const char* name, const std::vector<int16_t>& pcm, uint32_t sampleRate)
+{
+  FILE* f = fopen(name, "wb");
+
+  if (f == NULL)
+  {
+    printf("Cannot create %s\n", name);
+    return;
+  }
+
+  uint32_t bytes = pcm.size() * sizeof(int16_t);
+
+  fwrite("RIFF", 1, 4, f);  writeLE(f, 36 + bytes, 4);
+  fwrite("WAVEfmt ", 1, 8, f);
+  writeLE(f, 16, 4);              // fmt chunk size
+  writeLE(f, 1, 2);               // PCM
+  writeLE(f, 1, 2);               // mono
+  writeLE(f, sampleRate, 4);
+  writeLE(f, sampleRate * 2, 4);  // bytes per second
+  writeLE(f, 2, 2);               // bytes per sample
+  writeLE(f, 16, 2);              // bits per sample
+  fwrite("data", 1, 4, f);  writeLE(f, bytes, 4);
+  for (size_t i = 0; i < pcm.size(); i++)
+    writeLE(f, (uint16_t)pcm[i], 2);
+
+  fclose(f);
+}
+
+uint32_t sampleTime(uint32_t sample)
+// micros() time of a sample, rounded up so that the command is due
+{
+  return(((uint64_t)sample * 1000000 + SAMPLE_RATE - 1) / SAMPLE_RATE);
+}
+
+int main(int argc, char* argv[])
+{
+  uint16_t loops = 0;
+  double startTime = 0;
+  int arg = 1;
+
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+  {
+    if (argv[arg][1] == 'l') loops = atoi(argv[arg + 1]);
+    else if (argv[arg][1] == 's') startTime = atof(argv[arg + 1]);
+  }
+
+  if (arg >= argc)
+  {
+    printf("Usage: vgmplay [-l loops] [-s seconds] file.vgm|file.vgz [file.wav]\n");
+    return(1);
+  }
+
+  const char* vgmName = argv[arg];
+  const char* wavName = (arg + 1 < argc) ? argv[arg + 1] : "vgmplay.wav";
+  int fd = open(vgmName, O_RDONLY);
+  struct stat st;
+
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    printf("Cannot open %s\n", vgmName);
+    return(1);
+  }
+
+  const uint8_t* data = (const uint8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    printf("Cannot map %s\n", vgmName);
+    return(1);
+  }
+
+  MD_SN76489_VGMMemory mem(data, st.st_size);
+  static MD_SN76489_VGZSource src(mem);   // passes uncompressed data through
+  MD_SN76489_Emu E(SAMPLE_RATE);
+  MD_SN76489_VGM V(E);
+  static MD_SN76489_VGM::checkpoint_t index[64];
+  std::vector<int16_t> pcm;
+  uint32_t hash = 2166136261UL;   // FNV-1a
+
+  V.setLoops(loops);
+  V.setIndex(index, ARRAY_SIZE(index));
+  if (!V.start(src))
+  {
+    printf("%s is not a VGM file%s\n", vgmName, src.isError() ? " (error in the compressed data)" : "");
+    return(1);
+  }
+  E.begin(V.getClock() != 0 ? V.getClock() : 3579545);
+
+  printf("%s VGM version %x, clock %uHz, %.1fs, loop %.1fs\n", src.isCompressed() ? "Compressed" : "Uncompressed",
+    V.getVersion(), V.getClock(), (double)V.getTotalSamples() / SAMPLE_RATE, (double)V.getLoopSamples() / SAMPLE_RATE);
+
+  uint32_t timeStart = micros();
+
+  if (startTime > 0)
+  {
+    if (!V.seek(startTime * SAMPLE_RATE))
+    {
+      printf("Cannot seek to %.1fs\n", startTime);
+      return(1);
+    }
+    printf("Seek to %.1fs in %uus, %u checkpoints\n", startTime, micros() - timeStart, V.getIndexCount());
+    timeStart = micros();
+  }
+
+  // render a sample at a time, sending the writes due before each sample
+  for (uint32_t n = 0; V.poll(sampleTime(n)); n++)
+  {
+    pcm.push_back(0);
+    E.render(&pcm[n], 1);
+  }
+
+  double wall = (micros() - timeStart) / 1e6;
+  double seconds = (double)pcm.size() / SAMPLE_RATE;
+
+  for (size_t i = 0; i < pcm.size(); i++)
+  {
+    hash = (hash ^ (pcm[i] & 0xff)) * 16777619UL;
+    hash = (hash ^ ((uint16_t)pcm[i] >> 8)) * 16777619UL;
+  }
+
+  printf("Rendered %.1fs in %.3fs (%.0fx real time)\n", seconds, wall, seconds / wall);
+  printf("Checksum %08x\n", hash);
+
+  writeWav(wavName, pcm, SAMPLE_RATE);
+  munmap((void*)data, st.st_size);
+
+  return(0);
+}
@@ -0,0 +1,140 @@
+// MD_SN76489 host tool - convert a VGM file into a C header file.
+//
+// Writes the VGM file as a PROGMEM byte array, so that short tunes can be
+// built into a sketch and played with MD_SN76489_VGMMemory instead of
+// from an SD card:
+//
+//   #include "tune.h"
+//   MD_SN76489_VGMMemory src(tune, sizeof(tune), true);
+//
+// The GD3 tag (title, author, etc) at the end of the file is not needed
+// to play the music and is left out, unless -g is given. Compact stream
+// (.sns) files made by vgm2sns are written as they are.
+//
+// Build on the host from this folder with
+//   g++ -O2 MD_SN76489_VGMToH.cpp -o vgm2h
+//
+// Usage: vgm2h [-g] file.vgm|file.sns [file.h [array name]]
+//
+// The header is written to stdout if no output file is given. The array
+// name defaults to the input file name without the path or extension.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+const uint32_t HDR_EOF = 0x04;      // relative offset to the end of file
+const uint32_t HDR_GD3 = 0x14;      // relative offset to the GD3 tag
+const uint32_t HDR_LOOP = 0x1c;     // relative offset to the loop point
+const uint32_t HDR_SIZE = 0x40;     // smallest header
+const uint32_t SNS_HDR_SIZE = 24;   // compact stream header
+
+uint32_t getLE(const std::vector<uint8_t>& d, uint32_t pos)
+{
+  return(d[pos] | (d[pos + 1] << 8) | (d[pos + 2] << 16) | ((uint32_t)d[pos + 3] << 24));
+}
+
+void setLE(std::vector<uint8_t>& d, uint32_t pos, uint32_t v)
+{
+  for (uint8_t i = 0; i < 4; i++)
+    d[pos + i] = (v >> (8 * i)) & 0xff;
+}
+
+std::string arrayName(const char* file)
+// file name without the path or extension, made into a C identifier
+{
+  const char* p = strrchr(file, '/');
+  std::string s(p == NULL ? file : p + 1);
+  size_t dot = s.find('.');
+
+  if (dot != std::string::npos) s.erase(dot);
+  for (size_t i = 0; i < s.size(); i++)
+    if (!isalnum(s[i])) s[i] = '_';
+  if (s.empty() || isdigit(s[0])) s.insert(0, "vgm_");
+
+  return(s);
+}
+
+int main(int argc, char* argv[])
+{
+  bool keepGD3 = false;
+  int arg = 1;
+
+  if (arg < argc && strcmp(argv[arg], "-g") == 0)
+  {
+    keepGD3 = true;
+    arg++;
+  }
+
+  if (arg >= argc)
+  {
+    fprintf(stderr, "Usage: vgm2h [-g] file.vgm|file.sns [file.h [array name]]\n");
+    return(1);
+  }
+
+  const char* inName = argv[arg];
+  const char* outName = (arg + 1 < argc) ? argv[arg + 1] : NULL;
+  std::string name = (arg + 2 < argc) ? argv[arg + 2] : arrayName(inName);
+  FILE* f = fopen(inName, "rb");
+  std::vector<uint8_t> d;
+  int c;
+
+  if (f == NULL)
+  {
+    fprintf(stderr, "Cannot open %s\n", inName);
+    return(1);
+  }
+  while ((c = fgetc(f)) != EOF)
+    d.push_back(c);
+  fclose(f);
+
+  bool sns = (d.size() >= SNS_HDR_SIZE && memcmp(&d[0], "SNS\x01", 4) == 0);
+
+  if (!sns && (d.size() < HDR_SIZE || memcmp(&d[0], "Vgm ", 4) != 0))
+  {
+    fprintf(stderr, "%s is not a VGM file (compressed .vgz files must be unzipped first)\n", inName);
+    return(1);
+  }
+
+  // Leave out the GD3 tag if it is after the music data and the loop point
+  uint32_t gd3 = sns ? 0 : getLE(d, HDR_GD3);
+  uint32_t loop = sns ? 0 : getLE(d, HDR_LOOP);
+  size_t origSize = d.size();
+
+  if (!keepGD3 && gd3 != 0 && gd3 + HDR_GD3 < d.size() &&
+      (loop == 0 || loop + HDR_LOOP < gd3 + HDR_GD3))
+  {
+    d.resize(gd3 + HDR_GD3);
+    setLE(d, HDR_GD3, 0);
+    setLE(d, HDR_EOF, d.size() - HDR_EOF);
+  }
+
+  FILE* out = (outName == NULL) ? stdout : fopen(outName, "w");
+
+  if (out == NULL)
+  {
+    fprintf(stderr, "Cannot create %s\n", outName);
+    return(1);
+  }
+
+  fprintf(out, "// %s file %s converted by vgm2h\n", sns ? "Compact stream" : "VGM", inName);
+  fprintf(out, "// %zu bytes", d.size());
+  if (d.size() != origSize) fprintf(out, " (%zu bytes with the GD3 tag)", origSize);
+  fprintf(out, "\n#pragma once\n\n");
+  fprintf(out, "const uint8_t PROGMEM %s[] =\n{", name.c_str());
+  for (size_t i = 0; i < d.size(); i++)
+    fprintf(out, "%s0x%02x,", (i % 16 == 0) ? "\n  " : " ", d[i]);
+  fprintf(out, "\n};\n");
+
+  if (out != stdout) fclose(out);
+
+  fprintf(stderr, "%s: %zu bytes -> %s[%zu]\n", inName, origSize, name.c_str(), d.size());
+  if (d.size() > 32767)
+    fprintf(stderr, "Warning: more than 32767 bytes will not fit in an AVR array\n");
+
+  return(0);
+}
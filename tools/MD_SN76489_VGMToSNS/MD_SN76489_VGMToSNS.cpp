@@ -0,0 +1,686 @@
+// MD_SN76489 host tool - convert a VGM file into a compact stream file.
+//
+// The VGM (or compressed VGZ) file is played by MD_SN76489_VGM against a
+// virtual clock into an object that logs the bytes sent to the IC with
+// the sample they are sent at. The log is then written as a compact stream
+// (.sns) file, described in the library documentation (pageVGM):
+// - the writes at each sample are made into a frame holding only the
+//   registers that changed, tracked with MD_SN76489_Regs. A tone register
+//   that only changed its lower 4 bits is written with a latch byte alone,
+//   and one that only changed its upper 6 bits with a data byte alone if 
+//   it is still latched. Noise control writes are always kept, as they 
+//   reset the noise shift register.
+// - writes in the loop are kept if they change the IC either the first
+//   time through or when the loop is played again.
+// - the waits between frames are written in the shortest form, with the
+//   most common wait as the frame length for the one byte wait commands.
+// - repeated runs of frames and waits are replaced by a command to play
+//   the earlier copy again, where this makes the file smaller.
+//
+// The compact stream file is then checked by playing both files, twice
+// through the loop, and comparing the IC registers at every sample and
+// after seek() to random times. The sizes, compression ratio and the time
+// taken to decode each frame (in CPU cycles on x86, and in ns) for both
+// files are printed.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_VGMToSNS.cpp ../../src/*.cpp -o vgm2sns
+//
+// Usage: vgm2sns file.vgm|file.vgz [file.sns]
+//
+// The output file name defaults to the input file name with the extension
+// .sns. The exit status is 0 if the compact stream file played the same.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <MD_SN76489.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0ULL
+#endif
+
+const uint32_t SAMPLE_RATE = MD_SN76489_VGM::SAMPLE_RATE;
+const uint8_t REG_COUNT = MD_SN76489_Regs::REG_COUNT;
+const uint8_t NOISE_REG = MD_SN76489_Regs::NOISE_REG;
+
+// Compact stream header and commands
+const uint8_t SNS_HDR_SIZE = 24;
+const uint8_t SNS_END = 0x00;
+const uint8_t SNS_WAIT = 0x10;
+const uint8_t SNS_REPEAT = 0x20;
+const uint8_t SNS_DATA = 0x40;
+const uint8_t SNS_LATCH = 0x80;
+
+const uint8_t MIN_MATCH = 3;        // fewest tokens replaced by a repeat
+const uint16_t MAX_CHAIN = 256;     // earlier copies checked for each token
+const uint16_t SEEK_CHECKS = 50;    // random seeks checked
+const uint8_t STOP_WRITES = 4;      // attenuators turned off by stop()
+
+typedef std::vector<uint8_t> token_t;   // a register write or a wait
+
+struct write_t
+{
+  uint32_t sample;  // sample the byte is sent at
+  uint8_t data;     // byte sent to the IC
+};
+
+class MD_SN76489_Log: public MD_SN76489
+// Logs the bytes sent with the sample set by the caller
+{
+public:
+  MD_SN76489_Log(bool keep = true) : MD_SN76489(false), sample(0), _keep(keep)
+  {
+    begin();      // resets the register model, turning the attenuators off
+    log.clear();
+  }
+
+  std::vector<write_t> log;
+  uint32_t sample;
+
+protected:
+  void send(uint8_t data) { if (_keep) log.push_back({ sample, data }); }
+
+private:
+  bool _keep;
+};
+
+uint32_t sampleTime(uint32_t sample)
+// micros() time of a sample, rounded up so that the command is due
+{
+  return(((uint64_t)sample * 1000000 + SAMPLE_RATE - 1) / SAMPLE_RATE);
+}
+
+uint32_t play(MD_SN76489_VGM& V, MD_SN76489_Log* L)
+// Play to the end as fast as possible, moving the virtual clock straight
+// to the time of the next write. Returns the number of samples played.
+{
+  uint32_t now = 0, last = 0, looped = 0;
+
+  while (V.poll(now))
+  {
+    uint32_t pos = V.getSamplePos();
+
+    if (pos < last)   // gone back to the loop point
+      looped += V.getLoopSamples();
+    last = pos;
+    pos += looped;
+    if (L != NULL) L->sample = pos;
+    now = (sampleTime(pos) > now) ? sampleTime(pos) : now + 1;
+  }
+
+  // leave out the attenuator writes from stop(), which are not in the file
+  if (L != NULL && L->log.size() >= STOP_WRITES)
+    L->log.resize(L->log.size() - STOP_WRITES);
+
+  return(V.getSamplePos() + looped);
+}
+
+void putLE(std::vector<uint8_t>& d, uint32_t v, uint8_t size)
+{
+  for (uint8_t i = 0; i < size; i++)
+    d.push_back((v >> (8 * i)) & 0xff);
+}
+
+void putVar(token_t& t, uint32_t v)
+// Variable length number, 7 bits in each byte from the least significant
+{
+  while (v >= 0x80)
+  {
+    t.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  t.push_back(v);
+}
+
+uint8_t varSize(uint32_t v)
+{
+  uint8_t n = 1;
+
+  while (v >= 0x80) { v >>= 7; n++; }
+
+  return(n);
+}
+
+void putWait(std::vector<token_t>& tok, uint32_t w, uint16_t frame)
+// Shortest encoding of a wait
+{
+  uint32_t q = w / frame, r = w % frame;
+
+  if (q >= 1 && q <= 15 && r <= 15)
+  {
+    tok.push_back(token_t(1, q));
+    if (r != 0) tok.push_back(token_t(1, SNS_WAIT + r));
+  }
+  else if (w <= 15)
+    tok.push_back(token_t(1, SNS_WAIT + w));
+  else
+  {
+    token_t t(1, SNS_WAIT);
+
+    putVar(t, w);
+    tok.push_back(t);
+  }
+}
+
+void putReg(std::vector<token_t>& tok, MD_SN76489_Regs& out, uint8_t reg, uint16_t v, bool full, bool dataOnly)
+// Write a register, with the upper 6 bits of a tone register if full, or
+// only the upper 6 bits to the latched register if dataOnly
+{
+  uint8_t b = SNS_LATCH | (reg << 4) | (v & 0xf);
+
+  if (dataOnly)
+  {
+    tok.push_back(token_t(1, SNS_DATA | (v >> 4)));
+    out.decode(v >> 4);
+    return;
+  }
+
+  tok.push_back(token_t(1, b));
+  out.decode(b);
+  if (full && MD_SN76489_Regs::isTone(reg))
+  {
+    tok.push_back(token_t(1, SNS_DATA | (v >> 4)));
+    out.decode(v >> 4);
+  }
+}
+
+uint8_t regOf(uint8_t data, const MD_SN76489_Regs& regs)
+// Register written by a byte
+{
+  return((data & SNS_LATCH) ? (data >> 4) & 7 : regs.getLatched());
+}
+
+std::vector<token_t> tokenize(const std::vector<write_t>& log, uint32_t endSample,
+  uint32_t loopSample, bool loop, uint32_t loopWrites, uint32_t& loopTok, uint16_t& frame, uint32_t& frames)
+// Make the log into frames of changed registers and the waits between them.
+//
+// The loop is played first from the state at the loop point and then from
+// the state at the end of the data, so a write in the loop is only left 
+// out if it changes nothing in both. loopWrites is the number of writes at
+// the loop sample that come after the loop point in the VGM file.
+{
+  struct item_t { bool wait; uint32_t value; };   // wait samples or register write
+  std::vector<item_t> items;
+  std::map<uint32_t, uint32_t> waits;
+  MD_SN76489_Regs target, out, outLoop;
+  uint8_t written = 0;    // bit per register written since the loop point
+  bool latched = false;   // true once a latch byte is written, so the IC latch is known
+  bool loopLatched = false; // true once a latch byte is written in the loop
+  uint32_t at = 0;
+  size_t i = 0;
+  bool inLoop = false;
+  std::vector<token_t> tok;
+
+  // the state at the end of the data, when the loop is played again
+  outLoop.reset();
+  for (i = 0; i < log.size(); i++)
+    outLoop.decode(log[i].data);
+
+  target.reset();
+  out.reset();
+  loopTok = 0;
+  frames = 0;
+
+  for (i = 0; ; )
+  {
+    uint32_t next = (i < log.size()) ? log[i].sample : endSample;
+
+    if (loop && !inLoop && loopSample < next) next = loopSample;
+    if (next > at)
+    {
+      items.push_back({ true, next - at });
+      waits[next - at]++;
+      at = next;
+    }
+    if (i >= log.size() && (!loop || inLoop || loopSample != at))
+      break;
+
+    // the writes at this sample, split at the loop point
+    size_t last = i;
+
+    while (last < log.size() && log[last].sample == at)
+      last++;
+    if (loop && !inLoop && at == loopSample)
+    {
+      last -= loopWrites;
+      if (last == i)    // nothing before the loop point
+      {
+        inLoop = true;
+        loopTok = items.size();
+        last += loopWrites;
+      }
+    }
+
+    // noting any write to the noise register
+    bool noise = false;
+
+    for (; i < last; i++)
+    {
+      uint8_t r = regOf(log[i].data, target);
+
+      noise |= (r == NOISE_REG);
+      if (inLoop) written |= (1 << r);
+      target.decode(log[i].data);
+    }
+
+    // registers changed since the last frame, on the first time through or 
+    // on playing the loop again
+    uint32_t count = items.size();
+
+    for (uint8_t r = 0; r < REG_COUNT; r++)
+    {
+      if (!target.isKnown(r))
+        continue;
+
+      uint16_t v = target.get(r);
+      bool change = !out.isKnown(r) || out.get(r) != v || (r == NOISE_REG && noise);
+      bool full = !out.isKnown(r) || (out.get(r) >> 4) != (v >> 4);
+      bool low = !out.isKnown(r) || ((out.get(r) ^ v) & 0xf) != 0;
+      bool isLatched = latched && out.getLatched() == r;
+
+      if (inLoop && (written & (1 << r)))
+      {
+        change |= !outLoop.isKnown(r) || outLoop.get(r) != v;
+        full |= !outLoop.isKnown(r) || (outLoop.get(r) >> 4) != (v >> 4);
+        low |= !outLoop.isKnown(r) || ((outLoop.get(r) ^ v) & 0xf) != 0;
+      }
+      if (inLoop)   // the IC latch must be the same the first time and when looping
+        isLatched = isLatched && loopLatched && outLoop.getLatched() == r;
+      if (!change)
+        continue;
+
+      // upper bits only, with the register still latched
+      bool dataOnly = MD_SN76489_Regs::isTone(r) && full && !low && isLatched;
+
+      items.push_back({ false, (dataOnly ? 1U << 17 : 0) | (full ? 1U << 16 : 0) | (r << 12) | v });
+      if (!dataOnly)
+      {
+        out.decode(SNS_LATCH | (r << 4) | (v & 0xf));
+        if (inLoop) outLoop.decode(SNS_LATCH | (r << 4) | (v & 0xf));
+        latched = true;
+        loopLatched |= inLoop;
+      }
+      if (MD_SN76489_Regs::isTone(r) && (full || !dataOnly))
+      {
+        out.decode(v >> 4);
+        if (inLoop) outLoop.decode(v >> 4);
+      }
+    }
+    if (items.size() != count) frames++;
+
+    // the rest of the writes at the loop sample are after the loop point
+    if (loop && !inLoop && at == loopSample)
+    {
+      inLoop = true;
+      loopTok = items.size();
+    }
+  }
+
+  // frame length with the most waits, leaving out those with their own command
+  uint32_t most = 0;
+
+  frame = 735;
+  for (std::map<uint32_t, uint32_t>::const_iterator it = waits.begin(); it != waits.end(); it++)
+  {
+    if (it->first > 15 && it->first <= 0xffff && it->second > most)
+    {
+      most = it->second;
+      frame = it->first;
+    }
+  }
+
+  // encode, translating the loop point from items to tokens
+  uint32_t loopItem = loopTok;
+
+  out.reset();
+  for (i = 0; i < items.size(); i++)
+  {
+    if (i == loopItem)
+      loopTok = tok.size();
+    if (items[i].wait)
+      putWait(tok, items[i].value, frame);
+    else
+      putReg(tok, out, (items[i].value >> 12) & 0xf, items[i].value & 0x3ff, (items[i].value >> 16) & 1, items[i].value >> 17);
+  }
+  tok.push_back(token_t(1, SNS_END));
+
+  return(tok);
+}
+
+std::vector<uint8_t> compress(const std::vector<token_t>& tok, uint32_t loopTok, uint32_t& loopOffset, uint32_t& repeats)
+// Replace runs of tokens that are already in the output by a repeat command
+{
+  std::vector<uint8_t> out;
+  std::vector<uint32_t> pos(tok.size(), 0);   // output offset of each literal token
+  std::vector<bool> isLit(tok.size(), false);
+  std::vector<uint64_t> h(tok.size());
+  std::unordered_map<uint64_t, std::vector<uint32_t> > chains;
+  size_t n = tok.size() - 1;    // the end command is never repeated
+
+  for (size_t i = 0; i < tok.size(); i++)
+  {
+    h[i] = 14695981039346656037ULL;
+    for (size_t j = 0; j < tok[i].size(); j++)
+      h[i] = (h[i] ^ tok[i][j]) * 1099511628211ULL;
+  }
+
+  loopOffset = 0;
+  repeats = 0;
+  for (size_t i = 0; i < tok.size(); )
+  {
+    uint64_t key = (i + MIN_MATCH <= n) ? (h[i] * 31 + h[i + 1]) * 31 + h[i + 2] : 0;
+    uint32_t bestSave = 0, bestLen = 0, bestBack = 0, bestCount = 0;
+
+    if (i == loopTok)
+      loopOffset = out.size();
+
+    if (i + MIN_MATCH <= n && chains.count(key) != 0)
+    {
+      const std::vector<uint32_t>& c = chains[key];
+
+      for (size_t m = c.size(), tries = 0; m > 0 && tries < MAX_CHAIN; m--, tries++)
+      {
+        uint32_t j = c[m - 1];
+        uint32_t k = 0, len = 0;
+
+        // the loop point must be at the start of the repeat or outside it
+        while (i + k < n && j + k < i && isLit[j + k] && tok[j + k] == tok[i + k] && (k == 0 || i + k != loopTok))
+          len += tok[i + k++].size();
+
+        if (k < MIN_MATCH)
+          continue;
+
+        uint32_t back = out.size() - pos[j];
+        uint32_t cost = 1 + varSize(back) + varSize(len);
+
+        if (len > cost && len - cost > bestSave)
+        {
+          bestSave = len - cost;
+          bestLen = len;
+          bestBack = back;
+          bestCount = k;
+        }
+      }
+    }
+
+    if (bestSave != 0)
+    {
+      token_t t(1, SNS_REPEAT);
+
+      putVar(t, bestBack);
+      putVar(t, bestLen);
+      out.insert(out.end(), t.begin(), t.end());
+      i += bestCount;
+      repeats++;
+    }
+    else
+    {
+      pos[i] = out.size();
+      isLit[i] = true;
+      out.insert(out.end(), tok[i].begin(), tok[i].end());
+      if (i + MIN_MATCH <= n)
+        chains[key].push_back(i);
+      i++;
+    }
+  }
+
+  return(out);
+}
+
+bool sameRegs(const MD_SN76489_Regs& a, const MD_SN76489_Regs& b)
+// Registers known in a have the same value in b
+{
+  for (uint8_t r = 0; r < REG_COUNT; r++)
+    if (a.isKnown(r) && (!b.isKnown(r) || a.get(r) != b.get(r)))
+      return(false);
+
+  return(true);
+}
+
+uint32_t compareLogs(const std::vector<write_t>& a, const std::vector<write_t>& b)
+// Count the samples where the registers played from b differ from a, or a
+// noise register write in a is not in b.
+{
+  MD_SN76489_Regs ra, rb;
+  size_t i = 0, j = 0;
+  uint32_t errors = 0;
+
+  ra.reset();
+  rb.reset();
+  while (i < a.size() || j < b.size())
+  {
+    uint32_t s = (j >= b.size() || (i < a.size() && a[i].sample < b[j].sample)) ? a[i].sample : b[j].sample;
+    bool noiseA = false, noiseB = false;
+
+    for (; i < a.size() && a[i].sample == s; i++)
+    {
+      noiseA |= (((a[i].data & SNS_LATCH) ? (a[i].data >> 4) & 7 : ra.getLatched()) == NOISE_REG);
+      ra.decode(a[i].data);
+    }
+    for (; j < b.size() && b[j].sample == s; j++)
+    {
+      noiseB |= (((b[j].data & SNS_LATCH) ? (b[j].data >> 4) & 7 : rb.getLatched()) == NOISE_REG);
+      rb.decode(b[j].data);
+    }
+    if (!sameRegs(ra, rb) || (noiseA && !noiseB))
+    {
+      if (errors == 0) printf("First difference at sample %u\n", s);
+      errors++;
+    }
+  }
+
+  return(errors);
+}
+
+double decodeTime(MD_SN76489_VGMMemory& mem, uint32_t repeats, uint64_t& cycles)
+// Time to play the whole file with no output, in seconds for each time through
+{
+  static MD_SN76489_Log L(false);
+  MD_SN76489_VGM V(L);
+  uint32_t timeStart = micros();
+
+  V.setLoops(0);
+  cycles = CYCLES();
+  for (uint32_t i = 0; i < repeats; i++)
+  {
+    mem.reset();
+    V.start(mem);
+    play(V, NULL);
+  }
+  cycles = (CYCLES() - cycles) / repeats;
+
+  return((micros() - timeStart) / 1e6 / repeats);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: vgm2sns file.vgm|file.vgz [file.sns]\n");
+    return(1);
+  }
+
+  const char* inName = argv[1];
+  std::string outName;
+  FILE* f = fopen(inName, "rb");
+  std::vector<uint8_t> vgm;
+  int c;
+
+  if (argc > 2)
+    outName = argv[2];
+  else
+  {
+    const char* slash = strrchr(inName, '/');
+    const char* dot = strrchr(inName, '.');
+
+    outName = (dot != NULL && (slash == NULL || dot > slash)) ? std::string(inName, dot - inName) : inName;
+    outName += ".sns";
+  }
+
+  if (f == NULL)
+  {
+    printf("Cannot open %s\n", inName);
+    return(1);
+  }
+  while ((c = fgetc(f)) != EOF)
+    vgm.push_back(c);
+  fclose(f);
+
+  // play the VGM file once through, logging the writes
+  MD_SN76489_VGMMemory mem(vgm.data(), vgm.size());
+  static MD_SN76489_VGZSource src(mem);   // passes uncompressed data through
+  MD_SN76489_Log L;
+  MD_SN76489_VGM V(L);
+
+  V.setLoops(0);
+  if (!V.start(src) || V.getVersion() < 0x100)
+  {
+    printf("%s is not a VGM file%s\n", inName, src.isError() ? " (error in the compressed data)" : "");
+    return(1);
+  }
+
+  uint32_t clockHz = V.getClock();
+  uint32_t loopSamples = V.getLoopSamples();
+  uint32_t endSample = play(V, &L);
+  uint32_t totalSamples = V.getTotalSamples();
+  uint32_t loopSample = totalSamples - loopSamples;
+
+  // writes at the loop sample after the loop point, found from the writes 
+  // sent when the player goes back to the loop point
+  uint32_t loopWrites = 0;
+
+  if (loopSamples != 0)
+  {
+    MD_SN76489_Log LL;
+    MD_SN76489_VGM VL(LL);
+    uint32_t atEnd = 0, again = 0;
+
+    mem.reset();
+    src.reset();
+    VL.setLoops(1);
+    VL.start(src);
+    play(VL, &LL);
+    for (size_t i = 0; i < L.log.size(); i++)
+      atEnd += (L.log[i].sample == endSample);
+    for (size_t i = 0; i < LL.log.size(); i++)
+      again += (LL.log[i].sample == endSample);
+    loopWrites = again - atEnd;
+  }
+
+  // make the compact stream
+  uint32_t loopTok, frames, loopOffset, repeats;
+  uint16_t frame;
+  std::vector<token_t> tok = tokenize(L.log, endSample, loopSample, loopSamples != 0, loopWrites, loopTok, frame, frames);
+  std::vector<uint8_t> data = compress(tok, loopTok, loopOffset, repeats);
+  std::vector<uint8_t> sns;
+  size_t plain = 0;
+
+  for (size_t i = 0; i < tok.size(); i++)
+    plain += tok[i].size();
+
+  sns.insert(sns.end(), { 'S', 'N', 'S', 1 });
+  putLE(sns, clockHz, 4);
+  putLE(sns, totalSamples, 4);
+  putLE(sns, loopSamples != 0 ? SNS_HDR_SIZE + loopOffset : 0, 4);
+  putLE(sns, loopSamples, 4);
+  putLE(sns, frame, 2);
+  putLE(sns, SNS_HDR_SIZE, 2);
+  sns.insert(sns.end(), data.begin(), data.end());
+
+  f = fopen(outName.c_str(), "wb");
+  if (f == NULL || fwrite(sns.data(), 1, sns.size(), f) != sns.size())
+  {
+    printf("Cannot write %s\n", outName.c_str());
+    return(1);
+  }
+  fclose(f);
+
+  printf("%s: %zu bytes, %.1fs, loop %.1fs, %u frames with writes, %zu bytes written to the IC\n", inName,
+    vgm.size(), (double)totalSamples / SAMPLE_RATE, (double)loopSamples / SAMPLE_RATE, frames, L.log.size());
+  printf("%s: %zu bytes, frame %u samples, %zu bytes before %u repeats\n", outName.c_str(),
+    sns.size(), frame, plain + SNS_HDR_SIZE, repeats);
+  printf("Ratio %.2f:1 (%.1f%%)", (double)vgm.size() / sns.size(), 100.0 * sns.size() / vgm.size());
+
+  // the uncompressed VGM data, to compare the decode time
+  std::vector<uint8_t> raw;
+  const uint8_t* p;
+  size_t n;
+
+  mem.reset();
+  src.reset();
+  while ((n = src.read(p)) != 0)
+  {
+    raw.insert(raw.end(), p, p + n);
+    src.idle();
+  }
+  if (src.isCompressed())
+    printf(", %.2f:1 to the uncompressed VGM file (%zu bytes)", (double)raw.size() / sns.size(), raw.size());
+  printf("\n");
+
+  // check that both files play the same, twice through the loop
+  MD_SN76489_VGMMemory snsMem(sns.data(), sns.size());
+  MD_SN76489_Log LV, LS;
+  MD_SN76489_VGM VV(LV), VS(LS);
+  uint32_t errors;
+
+  mem.reset();
+  src.reset();
+  VV.setLoops(1);
+  VS.setLoops(1);
+  if (!VV.start(src) || !VS.start(snsMem))
+  {
+    printf("Cannot play the files to check them\n");
+    return(1);
+  }
+  uint32_t loopedSamples = play(VV, &LV);
+
+  errors = (play(VS, &LS) != loopedSamples);
+  errors += compareLogs(LV.log, LS.log);
+
+  printf("Played %u samples, %zu and %zu bytes written\n", loopedSamples, LV.log.size(), LS.log.size());
+
+  // seek both files to random times in the first time through, and compare the registers
+  srand(1);
+  for (uint16_t i = 0; i < SEEK_CHECKS && endSample != 0; i++)
+  {
+    uint32_t s = ((uint64_t)rand() * endSample) / ((uint64_t)RAND_MAX + 1);
+    MD_SN76489_Log SV(false), SS(false);
+    MD_SN76489_VGM V1(SV), V2(SS);
+
+    mem.reset();
+    src.reset();
+    snsMem.reset();
+    V1.setLoops(1);
+    V2.setLoops(1);
+    if (!V1.start(src) || !V2.start(snsMem) || !V1.seek(s) || !V2.seek(s) || !sameRegs(SV.getRegs(), SS.getRegs()))
+    {
+      if (errors == 0) printf("Different after seek to sample %u\n", s);
+      errors++;
+    }
+  }
+  printf("Check %s (%u seeks)\n", errors == 0 ? "OK" : "FAILED", SEEK_CHECKS);
+
+  // decode speed, for each frame with writes
+  uint32_t repeat = 1 + 20000000 / (L.log.size() + 1);
+  MD_SN76489_VGMMemory rawMem(raw.data(), raw.size());
+  uint64_t cyclesV, cyclesS;
+  double timeV = decodeTime(rawMem, repeat, cyclesV);
+  double timeS = decodeTime(snsMem, repeat, cyclesS);
+
+  if (frames == 0) frames = 1;
+  printf("Decode VGM %.0fns", timeV * 1e9 / frames);
+  if (cyclesV != 0) printf(" (%llu cycles)", (unsigned long long)(cyclesV / frames));
+  printf(", compact stream %.0fns", timeS * 1e9 / frames);
+  if (cyclesS != 0) printf(" (%llu cycles)", (unsigned long long)(cyclesS / frames));
+  printf(" per frame\n");
+
+  return(errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,170 @@
+// MD_SN76489 host tool - VGZ (gzip) decompression check and benchmark.
+//
+// Decompresses a .vgz file held in memory with MD_SN76489_VGZSource, a
+// block at a time as the VGM player reads it, and
+// - checks the decompressed data against the CRC32 and length at the end
+//   of the gzip file
+// - reports the decompression speed in MB/s of decompressed data
+// - reports the peak RAM used: the size of the object (window, tables and
+//   state) and the stack used by the decoder. The decoder does not use the
+//   heap.
+//
+// The stack use is measured by filling an area of the stack with a
+// pattern before decompressing and finding how much of it was changed.
+//
+// Build on the host from this folder with
+//   g++ -O2 -I../../src MD_SN76489_VGZBench.cpp ../../src/*.cpp -o vgzbench
+//
+// Usage: vgzbench file.vgz [repeats]
+//
+// The exit status is 0 if the data decompressed correctly.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <MD_SN76489.h>
+
+const size_t STACK_PAINT = 16384;   // bytes of stack checked
+const uint8_t PAINT = 0xa5;
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len)
+{
+  crc = ~crc;
+  while (len-- > 0)
+  {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xedb88320UL & -(crc & 1));
+  }
+
+  return(~crc);
+}
+
+__attribute__((noinline)) uint8_t paintStack(void)
+{
+  volatile uint8_t area[STACK_PAINT];
+
+  for (size_t i = 0; i < STACK_PAINT; i++)
+    area[i] = PAINT;
+
+  return(area[0]);
+}
+
+// the area is left as it was by the decoder, so it is not initialised here
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+__attribute__((noinline)) size_t checkStack(void)
+// Bytes of the painted area changed, counting from the end nearest the
+// caller's frame (the stack grows down).
+{
+  volatile uint8_t area[STACK_PAINT];
+  size_t i;
+
+  for (i = 0; i < STACK_PAINT; i++)
+    if (area[i] != PAINT) break;
+
+  return(STACK_PAINT - i);
+}
+
+__attribute__((noinline)) uint32_t decompress(MD_SN76489_VGZSource& Z, uint32_t& crc)
+// Read all the data as the player does, returns the number of bytes
+{
+  const uint8_t* data;
+  size_t len;
+  uint32_t total = 0;
+
+  while ((len = Z.read(data)) != 0)
+  {
+    crc = crc32(crc, data, len);
+    total += len;
+    Z.idle();
+  }
+
+  return(total);
+}
+
+__attribute__((noinline)) uint32_t decompressOnly(MD_SN76489_VGZSource& Z)
+{
+  const uint8_t* data;
+  size_t len;
+  uint32_t total = 0;
+
+  while ((len = Z.read(data)) != 0)
+  {
+    total += len;
+    Z.idle();
+  }
+
+  return(total);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: vgzbench file.vgz [repeats]\n");
+    return(1);
+  }
+
+  uint32_t repeats = (argc > 2) ? atol(argv[2]) : 20;
+  FILE* f = fopen(argv[1], "rb");
+  std::vector<uint8_t> gz;
+  int c;
+
+  if (f == NULL)
+  {
+    printf("Cannot open %s\n", argv[1]);
+    return(1);
+  }
+  while ((c = fgetc(f)) != EOF)
+    gz.push_back(c);
+  fclose(f);
+
+  MD_SN76489_VGMMemory M(gz.data(), gz.size());
+  static MD_SN76489_VGZSource Z(M);   // static, as it is too big for some stacks
+  uint32_t crc = 0, total;
+  size_t stack;
+
+  // check the data and measure the stack
+  paintStack();
+  total = decompress(Z, crc);
+  stack = checkStack();
+
+  if (!Z.isCompressed())
+  {
+    printf("%s is not gzip compressed\n", argv[1]);
+    return(1);
+  }
+  if (Z.isError())
+  {
+    printf("Error in the compressed data after %u bytes\n", total);
+    return(1);
+  }
+
+  size_t n = gz.size();
+  uint32_t crcFile = gz[n - 8] | (gz[n - 7] << 8) | (gz[n - 6] << 16) | ((uint32_t)gz[n - 5] << 24);
+  uint32_t sizeFile = gz[n - 4] | (gz[n - 3] << 8) | (gz[n - 2] << 16) | ((uint32_t)gz[n - 1] << 24);
+
+  printf("%s: %zu bytes compressed, %u bytes decompressed (%.1f%%)\n", argv[1], n, total, 100.0 * n / total);
+  printf("CRC32 %08x, file %08x, length %s: %s\n", crc, crcFile,
+    (total == sizeFile) ? "ok" : "WRONG", (crc == crcFile && total == sizeFile) ? "OK" : "DIFFERENT");
+
+  // time the decompression alone
+  uint32_t timeStart = micros();
+
+  for (uint32_t i = 0; i < repeats; i++)
+  {
+    M.reset();
+    Z.reset();
+    decompressOnly(Z);
+  }
+
+  double wall = (micros() - timeStart) / 1e6;
+
+  printf("Speed %.1f MB/s decompressed (%u repeats)\n", (double)total * repeats / wall / 1e6, repeats);
+  printf("RAM %zu bytes object (%u byte window) + %zu bytes stack, no heap\n",
+    sizeof(Z), MD_SN76489_VGZSource::WINDOW_SIZE, stack);
+
+  return((crc == crcFile && total == sizeFile) ? 0 : 1);
+}